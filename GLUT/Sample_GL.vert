@@ -3,20 +3,34 @@
 // input data : sent from main program
 layout (location = 0) in vec3 vertexPosition;
 layout (location = 1) in vec3 vertexColor;
+// per-instance data : x = rotation (radians), yz = offset
+// Left disabled for ordinary draws, where it reads as zero
+layout (location = 2) in vec3 instanceData;
+// per-instance depth layer, keeps batched draws in submission order
+layout (location = 3) in float instanceDepth;
 
-uniform mat4 MVP;
+// View-projection, shared by every program and uploaded once per frame
+layout (std140) uniform Camera {
+    mat4 VP;
+};
+// Model matrix of unbatched draws (identity when the model comes per instance)
+uniform mat4 Model;
 
 // output data : used by fragment shader
 out vec3 fragColor;
 
 void main ()
 {
-    vec4 v = vec4(vertexPosition, 1); // Transform an homogeneous 4D vector
+    // Rotate and offset this copy of the model (identity when not instanced)
+    float c = cos(instanceData.x), s = sin(instanceData.x);
+    vec2 p = mat2(c, s, -s, c) * vertexPosition.xy + instanceData.yz;
+
+    vec4 v = vec4(p, vertexPosition.z + instanceDepth, 1); // Transform an homogeneous 4D vector
 
     // The color of each vertex will be interpolated
     // to produce the color of each fragment
     fragColor = vertexColor;
 
-    // Output position of the vertex, in clip space : MVP * position
-    gl_Position = MVP * v;
+    // Output position of the vertex, in clip space : VP * Model * position
+    gl_Position = VP * Model * v;
 }
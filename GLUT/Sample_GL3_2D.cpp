@@ -5,8 +5,6 @@
 #include <fstream>
 #include <vector>
 #include <map>
-#include <bitset>
-#include <sstream>
 #include <GL/glew.h>
 #include <GL/glu.h>
 #include <GL/freeglut.h>
@@ -15,178 +13,71 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #define PI M_PI
+#include "../render.h"
+#include "../physics.h"
+#include "../offscreen.h"
+#include "../profiler.h"
+#include "../shadercache.h"
+#include "../shadersource.h"
+#include "embedded_shaders.h"
+#include "../shaderprograms.h"
+#include "../hotreload.h"
+#include "../segmenttext.h"
+#include "../bitmaptext.h"
+#include "../trajectorypreview.h"
 
 using namespace std;
-typedef struct VAO {
-    GLuint VertexArrayID;
-    GLuint VertexBuffer;
-    GLuint ColorBuffer;
-
-    GLenum PrimitiveMode;
-    GLenum FillMode;
-    int NumVertices;
-}VAO;
-struct GLMatrices {
-    glm::mat4 projection;
-    glm::mat4 model;
-    glm::mat4 view;
-    GLuint MatrixID;
-} Matrices;
 GLuint programID;
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path)
-{
-    GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-    GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-    std::string VertexShaderCode;
-    std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-    if(VertexShaderStream.is_open())
-    {
-        std::string Line = "";
-        while(getline(VertexShaderStream, Line))
-            VertexShaderCode += "\n" + Line;
-        VertexShaderStream.close();
-    }
-    std::string FragmentShaderCode;
-    std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-    if(FragmentShaderStream.is_open()){
-        std::string Line = "";
-        while(getline(FragmentShaderStream, Line))
-            FragmentShaderCode += "\n" + Line;
-        FragmentShaderStream.close();
-    }
-    GLint Result = GL_FALSE;
-    int InfoLogLength;
-    printf("Compiling shader : %s\n", vertex_file_path);
-    char const * VertexSourcePointer = VertexShaderCode.c_str();
-    glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-    glCompileShader(VertexShaderID);
-    glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-    glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-    std::vector<char> VertexShaderErrorMessage(InfoLogLength);
-    glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-    fprintf(stdout, "%s\n", &VertexShaderErrorMessage[0]);
-    printf("Compiling shader : %s\n", fragment_file_path);
-    char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-    glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-    glCompileShader(FragmentShaderID);
-    glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-    glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-    std::vector<char> FragmentShaderErrorMessage(InfoLogLength);
-    glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-    fprintf(stdout, "%s\n", &FragmentShaderErrorMessage[0]);
-    fprintf(stdout, "Linking program\n");
-    GLuint ProgramID = glCreateProgram();
-    glAttachShader(ProgramID, VertexShaderID);
-    glAttachShader(ProgramID, FragmentShaderID);
-    glLinkProgram(ProgramID);
-    glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-    glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-    std::vector<char> ProgramErrorMessage( max(InfoLogLength, int(1)) );
-    glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-    fprintf(stdout, "%s\n", &ProgramErrorMessage[0]);
-    glDeleteShader(VertexShaderID);
-    glDeleteShader(FragmentShaderID);
-    return ProgramID;
-}
-VAO* create3DObject(GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
-{
-    VAO* vao = new struct VAO;
-    vao->PrimitiveMode = primitive_mode;
-    vao->NumVertices = numVertices;
-    vao->FillMode = fill_mode;
-    glGenVertexArrays(1, &(vao->VertexArrayID));
-    glGenBuffers (1, &(vao->VertexBuffer));
-    glGenBuffers (1, &(vao->ColorBuffer));
-    glBindVertexArray (vao->VertexArrayID); 
-    glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer); 
-    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), vertex_buffer_data, GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,(void*)0);
-    glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer);
-    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), color_buffer_data, GL_STATIC_DRAW);
-    glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,0,(void*)0);
-    return vao;
-}
-void draw3DObject (struct VAO* vao)
-{
-    glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
-    glBindVertexArray (vao->VertexArrayID);
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vao->VertexBuffer);
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
-    glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices);
-}
 /***************************************************** SELF DEFINED FUNCTIONS ***************************************************************/
 
 #define F first
 #define S second
 #define mp make_pair
 #define pb push_back
-#define MAX 1000
 
 typedef pair< float, float > dub;
 typedef pair< dub ,float > tup;
-map<char,int> value;
-bitset<8> ok;
 
 int width,height;
-VAO* objects[MAX];
+//All body state lives in the store, these name its arrays
+BodyStore bodies;
+vector<VAO*> objects; //mesh of each body slot
 VAO* strokes[8];
-float Mass[MAX];
-float velx[MAX];
-float vely[MAX];
-float Timer[MAX];
-float startX[MAX];
-float startY[MAX];
-bool movable[MAX];
-int count[MAX]={0};
+vector<float>& Mass=bodies.Mass;
+vector<float>& velx=bodies.velx;
+vector<float>& vely=bodies.vely;
+vector<float>& Timer=bodies.Timer;
+vector<float>& startX=bodies.startX;
+vector<float>& startY=bodies.startY;
+vector<char>& movable=bodies.movable;
+vector<char>& solid=bodies.solid;
+vector<int>& count=bodies.count;
+//Scene slots are created in order by initGL, these two are the ones the game logic keeps asking about
+#define SCENE_BODIES 34
+int projectile=9,upperBlock=13;
 int score=0;
 float COR=0.6f;
 float ADG=1.0f;
 float tick=0.6f;
+//Physics steps at a fixed rate of its own, -hz and -speed on the command line
+FixedStep simClock={60.0f,1.0f,8,-1.0,0.0,0.0f};
 float Lx=15.0f,Ly=20.0f;
+//Score glyphs, Lx by Ly half sizes with 5 between them
+SegmentText scoreText=segmentText(Lx,Ly,2*Lx+5,102,51,0);
+int shownScore=-1;
 
-vector< tup > centre[MAX];
-glm::vec3 trans[MAX];
-float rotat[MAX];
+vector< vector<tup> >& centre=bodies.centre;
+vector<glm::vec3>& trans=bodies.trans;
+vector<float>& rotat=bodies.rotat;
 
-float formatAngle(float A)
-{
-    if(A<0.0f)
-        return A+360.0f;
-    if(A>=360.0f)
-        return A-360.0f;
-    return A;
-}
-float D2R(float A)
-{
-    return (A*PI)/180.0f;
-}
 float sqr(float x)
 {
     return x*x;
 }
-float dis(dub p,dub q)
-{
-    return sqr(p.F-q.F)+sqr(p.S-q.S);
-}
 
-void *font = GLUT_BITMAP_TIMES_ROMAN_24;
-void *fonts[] =
-{
-    GLUT_BITMAP_9_BY_15,
-    GLUT_BITMAP_TIMES_ROMAN_10,
-    GLUT_BITMAP_TIMES_ROMAN_24
-};
 char defaultMessage[] = "GLUT means OpenGL.";
 char *message = defaultMessage;
 
-void selectFont(int newfont)
-{
-    font = fonts[newfont];
-    glutPostRedisplay();
-}
-
 void selectColor(int color)
 {
     switch (color) {
@@ -203,94 +94,105 @@ void selectColor(int color)
     glutPostRedisplay();
 }
 
-void output(int x, int y, char str[])
+int offscreenFrame=-1; //Frame being rendered offscreen, -1 in a window
+const char* profilePath="profile.csv"; //Written by the 'o' key, and after offscreen runs given -profile
+
+//Seconds the simulation clock reads, offscreen frames are 1/60 s apart whatever they take
+double frameTime()
 {
-    int len, i;
-    glRasterPos2f(x, y);
-    len = (int) strlen(str);
-    for (i = 0; i < len; i++) 
-    {
-        glutBitmapCharacter(font, str[i]);
-    }
+    if(offscreenFrame>=0)
+        return offscreenFrame/60.0;
+    return glutGet(GLUT_ELAPSED_TIME)/1000.0;
 }
 
-float toBits(int a)
+//Pixel of a world point, from the top left of the viewport, to put text next to world geometry
+glm::vec2 worldToPixel(float x,float y)
 {
-    ok.reset();
-    for(int i=0;i<8;i++)
-    {
-        if((a>>i)&1)
-        {
-            ok.set(i);
-        }
-
-    }
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT,viewport);
+    glm::vec4 clip=cameraVP()*glm::vec4(x,y,0,1);
+    return glm::vec2((clip.x+1)/2*viewport[2],(1-clip.y)/2*viewport[3]);
 }
 
 /********************************************************** AIR FRICTION ********************************************************************/
 
-float EKMT(float K,float M,float T)
-{
-    return exp(-((K/M)*T));
-}
-float xvel(float V0,float K,float M,float T)
-{
-    return V0*EKMT(K,M,T);
-}
-float xdis(float V0,float K,float M,float T)
+//xvel/xdis/yvel/ydis and the batched dragTrajectory() are in physics.h
+float equilib(int i)
 {
-    return ((M/K)*V0)*(1.0f-EKMT(K,M,T));
+    return (Mass[i]/0.3f)*((vely[i]*0.3f+1.0f)/(Mass[i]*ADG));
 }
-float yvel(float V0,float K,float M,float T,float G)
+
+/*********************************************************** DETECTING COLLISIONS ***********************************************************/
+
+
+//centre[] placed by trans[]/rotat[], refreshed on use
+const WorldCircles& bodyCircles(int i)
 {
-    return ((V0+((M*G)/K))*EKMT(K,M,T))-((M*G)/K);
+    return updateWorldCircles(bodies.world[i],trans[i],rotat[i],centre[i]);
 }
-float ydis(float V0,float K,float M,float T,float G)
+
+int collisionChecks=0; //checkCollision calls since the last trace counter sample
+bool checkCollision(int i,int j)
 {
-    return ((M/K)*(V0+((M*G)/K))*(1-EKMT(K,M,T)))-((M*G*T)/K);
+    collisionChecks++;
+    return circlesOverlap(bodyCircles(i),bodyCircles(j));
 }
-float equilib(int i)
+
+//Rebuilt once per frame in draw(), the margin covers the small moves made by the collision responses
+BroadphaseGrid collisionGrid=broadphaseGrid(64.0f);
+
+//Grid first, circles only for pairs that share a cell
+bool touching(int i,int j)
 {
-    return (Mass[i]/0.3f)*((vely[i]*0.3f+1.0f)/(Mass[i]*ADG));
+    return mayCollide(collisionGrid,i,j) && checkCollision(i,j);
 }
 
-/*********************************************************** DETECTING COLLISIONS ***********************************************************/
-
+#define CONTACT_SKIN 0.5f //overlap a swept body is left with at its contact
 
-int collided(tup p,tup q)
+//Move i straight down onto j, the drop to contact in closed form. Stays put when already touching or j is not below.
+void dropOnto(int i,int j)
 {
-    float cdis=dis(p.F,q.F);
-    float rsum=sqr(p.S+q.S);
-    if(cdis<=rsum)
-        return 1;
-    else
-        return 0;
+    const float drop=600.0f; //the height of the scene
+    collisionChecks++;
+    float t=sweepContact(bodyCircles(i),bodyCircles(j),0.0f,-drop,CONTACT_SKIN);
+    if(t>=0.0f)
+        trans[i][1]-=t*drop;
 }
 
-bool checkCollision(int i,int j)
+//Bodies around the projectile's move. moveProjectile() runs before the step rebuilds the grid,
+//so they come from the last step's grid, which still holds the solids where they are: they never move
+vector<int> impactCandidates;
+
+//Earliest fraction of the move (dx,dy) at which the projectile meets a solid body, or -1
+float firstImpact(float dx,float dy)
 {
-    float R;
-    tup A,B,V;
-    for(int k=0;k<centre[i].size();k++)
+    const WorldCircles& moving=bodyCircles(projectile);
+    Bounds swept=bodyBounds(moving,CONTACT_SKIN); //grown to cover the whole move
+    (dx<0.0f ? swept.minX : swept.maxX)+=dx;
+    (dy<0.0f ? swept.minY : swept.maxY)+=dy;
+    impactCandidates.clear();
+    bodiesInBox(collisionGrid,swept,impactCandidates);
+    float first=-1.0f;
+    for(int a=0;a<(int)impactCandidates.size();a++)
     {
-        for(int l=0;l<centre[j].size();l++)
-        {
-            V=centre[i][k];
-            R=V.F.F;
-            A.F.F=trans[i][0]+R*cos(D2R(formatAngle(rotat[i])));
-            A.F.S=trans[i][1]+R*sin(D2R(formatAngle(rotat[i])));
-            A.S=V.S;
-
-            V=centre[j][l];
-            R=V.F.F;
-            B.F.F=trans[j][0]+R*cos(D2R(formatAngle(rotat[j])));
-            B.F.S=trans[j][1]+R*sin(D2R(formatAngle(rotat[j])));
-            B.S=V.S;
-            if(collided(A,B))
-                return true;
-        }
+        int j=impactCandidates[a];
+        if(j==projectile || !solid[j])
+            continue;
+        collisionChecks++;
+        float t=sweepContact(moving,bodyCircles(j),dx,dy,CONTACT_SKIN);
+        if(t>=0.0f && (first<0.0f || t<first))
+            first=t;
     }
-    return false;
+    return first;
+}
+
+//Where the shot would go, drawn while aiming, with the drag model it flies
+TrajectoryPreview aimPreview=trajectoryPreview(256,150.0f,0.3f,255,255,0);
+
+//The power-ups are flown through, so the preview goes on past them
+bool stopsPreview(int j)
+{
+    return j!=28 && j!=29;
 }
 
 /***************************************************** KEYBOARD AND MOUSE FUNCTIONS  *******************************************************/
@@ -307,6 +209,7 @@ void keyboardDown(unsigned char key, int x, int y)
     switch(key)
     {
         case 'Q':
+            clearMeshCache();
             exit(0);
             break;
         case 'f':
@@ -318,9 +221,15 @@ void keyboardDown(unsigned char key, int x, int y)
         case ' ':
             speed=30*(xmousepos/400);
             buttonPressed=1;
-            velx[9]=speed*(cos(rotateBarrel*(M_PI/180)));
-            vely[9]=speed*(sin(rotateBarrel*(M_PI/180)));
-            Timer[9]=0.0f;
+            velx[projectile]=speed*(cos(rotateBarrel*(M_PI/180)));
+            vely[projectile]=speed*(sin(rotateBarrel*(M_PI/180)));
+            Timer[projectile]=0.0f;
+            break;
+        case 'p':
+            profiler.overlay=!profiler.overlay;
+            break;
+        case 'o':
+            dumpProfile(profilePath);
             break;
         case 'q':
             exit(0);
@@ -378,18 +287,18 @@ void mouseClick(int button, int state, int x, int y)
     if(button==GLUT_LEFT_BUTTON && state==GLUT_DOWN)
     {
         buttonPressed=1;
-        velx[9]=speed*(cos(rotateBarrel*(M_PI/180)));
-        vely[9]=speed*(sin(rotateBarrel*(M_PI/180)));
-        Timer[9]=0.0f;
+        velx[projectile]=speed*(cos(rotateBarrel*(M_PI/180)));
+        vely[projectile]=speed*(sin(rotateBarrel*(M_PI/180)));
+        Timer[projectile]=0.0f;
     }
     if(button==GLUT_RIGHT_BUTTON && state==GLUT_DOWN)
     {
         buttonPressed=0;
         //radius=10.0f;
         rotateBarrel=0.0f;
-        velx[9]=32.0f;
-        vely[9]=0.0f;
-        Timer[9]=0.0f;
+        velx[projectile]=32.0f;
+        vely[projectile]=0.0f;
+        Timer[projectile]=0.0f;
     }
     if(button==4)
     {
@@ -412,85 +321,143 @@ void cursorPos(int x, int y)
 {
     xmousepos=x;
     ymousepos=y;
-    trans[9][0]=speed*cos(D2R(rotateBarrel));
-    trans[9][1]=speed*sin(D2R(rotateBarrel));
+    trans[projectile][0]=speed*cos(D2R(rotateBarrel));
+    trans[projectile][1]=speed*sin(D2R(rotateBarrel));
 }
 
 void reshapeWindow(int width, int height)
 {
     GLfloat fov=90.0f;
     glViewport(0, 0, (GLsizei) width, (GLsizei) height);
-    Matrices.projection=glm::ortho(-zoomX/2.0f,zoomX/2.0f,-zoomY/2.0f,zoomY/2.0f,0.1f, 500.0f);
+    setOrtho(-zoomX/2.0f,zoomX/2.0f,-zoomY/2.0f,zoomY/2.0f,0.1f, 500.0f);
 }
 
+//colours[] holds the 6 per-vertex colours of the old triangle list, the corners take entries 0,1,2,4
 VAO* createRectangle(float x,float y, GLfloat colours[])
 {
+    float params[]={x,y};
+    string key=meshKey("rectangle",params,2,colours,18);
+    if(VAO* mesh=findMesh(key))
+        return mesh;
     GLfloat vertex_buffer_data [] = {
         -x,-y,0.0, // vertex 1
         x,-y,0.0, // vertex 2
         x, y,0.0, // vertex 3
-
-        x, y,0.0, // vertex 3
-        -x, y,0.0, // vertex 4
-        -x,-y,0.0  // vertex 1
-    };
-    GLfloat color_buffer_data [] = {
-        1,0,0, // color 1
-        1,0,0, // color 2
-        1,0,0, // color 3
-        1,0,0, // color 3
-        1,0,0, // color 4
-        1,0,0  // color 1
+        -x, y,0.0  // vertex 4
     };
-    return create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, colours, GL_FILL);
+    const int corner[]={0,1,2,4};
+    GLfloat color_buffer_data [12];
+    for(int i=0;i<4;i++)
+        for(int k=0;k<3;k++)
+            color_buffer_data[3*i+k]=colours[3*corner[i]+k];
+    GLushort index_data[]={0,1,2,2,3,0};
+    std::vector<Vertex> vertices=packVertices(4,vertex_buffer_data,color_buffer_data);
+    return cacheMesh(key,createPooledObject(GL_TRIANGLES,4,&vertices[0],6,index_data,GL_FILL));
 }
 
+//Queued, drawn by flushRenderQueue() at the end of draw()
 void drawobject(VAO* obj,glm::vec3 trans,float angle,glm::vec3 rotat)
 {
-    Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0));
-    glm::mat4 VP = Matrices.projection * Matrices.view;
-    glm::mat4 MVP;
+    if(rotat==glm::vec3(0,0,1))
+    {
+        queueObject(obj,trans[0],trans[1],trans[2],D2R(formatAngle(angle)));
+        return;
+    }
     Matrices.model = glm::mat4(1.0f);
     glm::mat4 translatemat = glm::translate(trans);
     glm::mat4 rotatemat = glm::rotate(D2R(formatAngle(angle)), rotat);
     Matrices.model *= (translatemat * rotatemat);
-    MVP = VP * Matrices.model;
-    glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-    draw3DObject(obj);
+    queueObject(obj,Matrices.model);
 }
 
 VAO* createLine(float X1,float Y1,float X2,float Y2)
 {
+    float params[]={X1,Y1,X2,Y2};
+    string key=meshKey("line",params,4);
+    if(VAO* mesh=findMesh(key))
+        return mesh;
     GLfloat vertex_buffer_data[]={X1,Y1,0.0f,X2,Y2,0.0f};
     GLfloat color_buffer_data[]={102.0/255.0,51.0/255.0,0,102.0/255.0,51.0/255.0,0};
-    return create3DObject(GL_LINES,2,vertex_buffer_data,color_buffer_data,GL_LINE);
+    std::vector<Vertex> vertices=packVertices(2,vertex_buffer_data,color_buffer_data);
+    return cacheMesh(key,createPooledObject(GL_LINES,2,&vertices[0],0,NULL,GL_LINE));
 }
 
-VAO* createSector(float R,int parts,GLfloat colours[])
+//One sector of a circle cut into parts, not cached
+VAO* buildSector(float R,int parts,GLfloat colours[])
 {
     float diff=360.0f/parts;
     float A1=formatAngle(-diff/2);
     float A2=formatAngle(diff/2);
     GLfloat vertex_buffer_data[]={0.0f,0.0f,0.0f,R*cos(D2R(A1)),R*sin(D2R(A1)),0.0f,R*cos(D2R(A2)),R*sin(D2R(A2)),0.0f};
-    GLfloat color_buffer_data[]={1,0,0,1,0,0,1,0,0};
-    return create3DObject(GL_TRIANGLES,3,vertex_buffer_data,colours,GL_FILL);
+    std::vector<Vertex> vertices=packVertices(3,vertex_buffer_data,colours);
+    return createPooledObject(GL_TRIANGLES,3,&vertices[0],0,NULL,GL_FILL);
+}
+
+VAO* createSector(float R,int parts,GLfloat colours[])
+{
+    float params[]={R,(float)parts};
+    string key=meshKey("sector",params,2,colours,9);
+    VAO* mesh=findMesh(key);
+    return mesh ? mesh : cacheMesh(key,buildSector(R,parts,colours));
+}
+
+//Rotated sector copies from A1 to A2 every step degrees, cached together with the angles
+VAO* createArc(float R,int parts,float A1,float A2,float step,GLfloat colours[])
+{
+    float params[]={R,(float)parts,A1,A2,step};
+    string key=meshKey("arc",params,5,colours,9);
+    VAO* mesh=findMesh(key);
+    if(mesh)
+        return mesh;
+    mesh=buildSector(R,parts,colours);
+    setSectorInstances(mesh,A1,A2,step);
+    return cacheMesh(key,mesh);
+}
+
+//Whole disc, one instanced copy of the sector per part
+VAO* createDisc(float R,int parts,GLfloat colours[])
+{
+    return createArc(R,parts,0.0f,360.0f-360.0f/parts,360.0f/parts,colours);
+}
+
+//A disc at each of the puffs (x,y pairs), all one instanced sector. The puffs are part of the key,
+//so the cloud never comes back from createSector or another cloud
+VAO* createCloud(float R,int parts,const float puffs[][2],int numPuffs,GLfloat colours[])
+{
+    vector<float> params;
+    params.pb(R);
+    params.pb((float)parts);
+    for(int i=0;i<numPuffs;i++)
+    {
+        params.pb(puffs[i][0]);
+        params.pb(puffs[i][1]);
+    }
+    string key=meshKey("cloud",&params[0],params.size(),colours,9);
+    VAO* mesh=findMesh(key);
+    if(mesh)
+        return mesh;
+    mesh=buildSector(R,parts,colours);
+    vector<GLfloat> instances;
+    for(int i=0;i<numPuffs;i++)
+    {
+        for(int j=0;j<parts;j++)
+        {
+            instances.pb(D2R(j*360.0f/parts));
+            instances.pb(puffs[i][0]);
+            instances.pb(puffs[i][1]);
+        }
+    }
+    setInstances(mesh,instances.size()/3,&instances[0]);
+    return cacheMesh(key,mesh);
 }
 
 void trt(VAO* obj,double toX,double toY,double rot_angle,double width,double height)
 {
-    Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0));
-    glm::mat4 VP = Matrices.projection * Matrices.view;
-    glm::mat4 MVP;
-    Matrices.model = glm::mat4(1.0f);
-    glm::mat4 translatepivot= glm::translate(glm::vec3(width,height,0));
-    //glm::mat4 revtranslatepivot= glm::translate(glm::vec3(-width,-4*height,0));
-    glm::mat4 translatemat = glm::translate(glm::vec3(toX,toY,0));
-    glm::mat4 rotatemat = glm::rotate(D2R(formatAngle(rot_angle)), glm::vec3(0,0,1));
-    //Matrices.model *= (translatemat * revtranslatepivot * rotatemat * translatepivot);
-    Matrices.model *= (translatemat * rotatemat * translatepivot);
-    MVP = VP * Matrices.model;
-    glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-    draw3DObject(obj);
+    //translate * rotate * translate(pivot) is a rotation about the pivot, moved to toX,toY
+    float A=D2R(formatAngle(rot_angle));
+    float X=toX+cos(A)*width-sin(A)*height;
+    float Y=toY+sin(A)*width+cos(A)*height;
+    queueObject(obj,X,Y,0.0f,A);
 }
 
 void conserveMomentum(int i,int j)
@@ -510,28 +477,53 @@ void conserveMomentum(int i,int j)
     vely[j]=v2;
 }
 
+vector<float> pathX,pathY,pathVelX,pathVelY; //dragTrajectory() output, by body slot
 void moveProjectile()
 {
     if(buttonPressed==0)
     {
-        startX[9]=trans[9][0]=-314+speed*cos(D2R(rotateBarrel));
-        startY[9]=trans[9][1]=-190+speed*sin(D2R(rotateBarrel));
+        startX[projectile]=trans[projectile][0]=-314+speed*cos(D2R(rotateBarrel));
+        startY[projectile]=trans[projectile][1]=-190+speed*sin(D2R(rotateBarrel));
     }
+    //Every body's point on its path at once, one exp each
+    int n=bodyCount(bodies);
+    pathX.resize(n);
+    pathY.resize(n);
+    pathVelX.resize(n);
+    pathVelY.resize(n);
+    dragTrajectory(n,&startX[0],&startY[0],&velx[0],&vely[0],&Mass[0],&Timer[0],0.3f,ADG,&pathX[0],&pathY[0],&pathVelX[0],&pathVelY[0]);
     for(int i=1;i<16;i++)
     {
-        if(i==9 && buttonPressed==0)
+        if(i==projectile && buttonPressed==0)
         {
             continue;
         }
-        float veloy=yvel(vely[i],0.3f,Mass[i],Timer[i],ADG);
-        float velox=xvel(velx[i],0.3f,Mass[i],Timer[i]);
         if(velx[i]!=0.0f || vely[i]!=0.0f)
         {
-            trans[i][0]=startX[i]+xdis(velx[i],0.3f,Mass[i],Timer[i]);
-            if(i!=13)
+            float x=pathX[i];
+            float y=trans[i][1];
+            if(i!=upperBlock)
+            {
+                y=pathY[i];
+            }
+            //Left touching the first solid in the way, at the time it got there. The sweep starts
+            //from the last step's point of the path, as cursorPos() moves trans[projectile] too.
+            float t=-1.0f;
+            if(i==projectile)
             {
-                trans[i][1]=startY[i]+ydis(vely[i],0.3f,Mass[i],Timer[i],ADG);
+                float last=Timer[i]>=tick ? Timer[i]-tick : 0.0f;
+                trans[i][0]=startX[i]+xdis(velx[i],0.3f,Mass[i],last);
+                trans[i][1]=startY[i]+ydis(vely[i],0.3f,Mass[i],last,ADG);
+                t=firstImpact(x-trans[i][0],y-trans[i][1]);
             }
+            if(t>=0.0f)
+            {
+                x=trans[i][0]+(x-trans[i][0])*t;
+                y=trans[i][1]+(y-trans[i][1])*t;
+                Timer[i]-=(1.0f-t)*tick;
+            }
+            trans[i][0]=x;
+            trans[i][1]=y;
             Timer[i]+=tick;
         }
     }
@@ -545,229 +537,286 @@ float prevTransX,prevTransY;
 GLfloat green[]={0.0,1.0,0.0,0.0,1.0,0.0,0.0,1.0,0.0,0.0,1.0,0.0,0.0,1.0,0.0,0.0,1.0,0.0};
 GLfloat blueblack[]={0.0,0.0,51.0/255.0,0.0,0.0,51.0/255.0,0.0,0.0,51.0/255.0,0.0,0.0,51.0/255.0,0.0,0.0,51.0/255.0,0.0,0.0,51.0/255.0};
 
-void draw()
+//Passes of a frame for the profiler, registered by initGL
+int passPhysics,passCollisions,passWorld,passText,passSwap;
+
+//One fixed step: move the bodies, then bounce them off whatever they now touch
+void stepSimulation()
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram (programID);
-    char str[10]="Varshit";
-    output(0, 0, str);
-    Matrices.projection=glm::ortho(-(zoomX/2.0f)+panX,(zoomX/2.0f)+panX,-(zoomY/2.0f)+panY,(zoomY/2.0f)+panY,0.1f, 500.0f);
-    //output(100, 100, message);
-    //output(50, 145, "(positioned in pixels with upper-left origin)");
-    //Drawing objects
+    TRACE_SCOPE("stepSimulation");
+    beginPass(passPhysics);
     moveProjectile();
+    endPass(passPhysics);
+    beginPass(passCollisions);
+    buildBroadphase(collisionGrid,bodies,10.0f);
     //Topple projectile
-    if(checkCollision(9,10) && temp==false)
+    if(touching(projectile,10) && temp==false)
     {
         temp=true;
-        velx[9]=-COR*xvel(velx[9],0.3f,Mass[9],Timer[9]);
-        vely[9]=yvel(vely[9],0.3f,Mass[9],Timer[9],ADG);
-        startX[9]=trans[9][0];
-        startY[9]=trans[9][1];
-        Timer[9]=tick;
+        velx[projectile]=-COR*xvel(velx[projectile],0.3f,Mass[projectile],Timer[projectile]);
+        vely[projectile]=yvel(vely[projectile],0.3f,Mass[projectile],Timer[projectile],ADG);
+        startX[projectile]=trans[projectile][0];
+        startY[projectile]=trans[projectile][1];
+        Timer[projectile]=tick;
     }
     //Reflect from floor
-    if((velx[9]!=0.0f || vely[9]!=0.0f) && checkCollision(9,0))
+    if((velx[projectile]!=0.0f || vely[projectile]!=0.0f) && touching(projectile,0))
     {
-        velx[9]=xvel(velx[9],0.3f,Mass[9],Timer[9]);
-        vely[9]=-COR*yvel(vely[9],0.3f,Mass[9],Timer[9],ADG);
-        if((vely[9]<2.0f) && checkCollision(9,0))
+        velx[projectile]=xvel(velx[projectile],0.3f,Mass[projectile],Timer[projectile]);
+        vely[projectile]=-COR*yvel(vely[projectile],0.3f,Mass[projectile],Timer[projectile],ADG);
+        if((vely[projectile]<2.0f) && checkCollision(projectile,0))
         {
-            trans[9][1]=-270.0f;
-            velx[9]=0.0f;
-            vely[9]=0.0f;
-            Timer[9]=0.0f;
+            trans[projectile][1]=-270.0f;
+            velx[projectile]=0.0f;
+            vely[projectile]=0.0f;
+            Timer[projectile]=0.0f;
         }
         else
         {
-            trans[9][1]=-270.0f;
-            startX[9]=trans[9][0];
-            startY[9]=trans[9][1];
-            Timer[9]=tick;
+            trans[projectile][1]=-270.0f;
+            startX[projectile]=trans[projectile][0];
+            startY[projectile]=trans[projectile][1];
+            Timer[projectile]=tick;
         }
     }
 
     //Reflect from right wall
-    if((velx[9]!=0.0f || vely[9]!=0.0f) && checkCollision(9,1))
+    if((velx[projectile]!=0.0f || vely[projectile]!=0.0f) && touching(projectile,1))
     {
-        velx[9]=-COR*xvel(velx[9],0.3f,Mass[9],Timer[9]);
-        vely[9]=yvel(vely[9],0.3f,Mass[9],Timer[9],ADG);
-        trans[9][0]=360.0f;
-        startX[9]=trans[9][0];
-        startY[9]=trans[9][1];
-        Timer[9]=tick;
+        velx[projectile]=-COR*xvel(velx[projectile],0.3f,Mass[projectile],Timer[projectile]);
+        vely[projectile]=yvel(vely[projectile],0.3f,Mass[projectile],Timer[projectile],ADG);
+        trans[projectile][0]=360.0f;
+        startX[projectile]=trans[projectile][0];
+        startY[projectile]=trans[projectile][1];
+        Timer[projectile]=tick;
     }
 
     //Reflect from left wall
-    if((velx[9]!=0.0f || vely[9]!=0.0f) && checkCollision(9,3))
+    if((velx[projectile]!=0.0f || vely[projectile]!=0.0f) && touching(projectile,3))
     {
-        velx[9]=-COR*xvel(velx[9],0.3f,Mass[9],Timer[9]);
-        vely[9]=yvel(vely[9],0.3f,Mass[9],Timer[9],ADG);
-        trans[9][0]=-370.0f;
-        startX[9]=trans[9][0];
-        startY[9]=trans[9][1];
-        Timer[9]=tick;
+        velx[projectile]=-COR*xvel(velx[projectile],0.3f,Mass[projectile],Timer[projectile]);
+        vely[projectile]=yvel(vely[projectile],0.3f,Mass[projectile],Timer[projectile],ADG);
+        trans[projectile][0]=-370.0f;
+        startX[projectile]=trans[projectile][0];
+        startY[projectile]=trans[projectile][1];
+        Timer[projectile]=tick;
     }
 
     //Move upper block
-    if((velx[9]!=0.0f || vely[9]!=0.0f) && checkCollision(9,13))
+    if((velx[projectile]!=0.0f || vely[projectile]!=0.0f) && touching(projectile,upperBlock))
     {
-        count[13]+=1;
+        count[upperBlock]+=1;
         score+=20;
-        float prev=xvel(velx[9],0.3f,Mass[9],Timer[9]);
+        float prev=xvel(velx[projectile],0.3f,Mass[projectile],Timer[projectile]);
         if(prev>0.0f)
         {
-            startX[9]=trans[13][0]-40.0f;
+            startX[projectile]=trans[upperBlock][0]-40.0f;
         }
         else
         {
-            startX[9]=trans[13][0]+40.0f;
+            startX[projectile]=trans[upperBlock][0]+40.0f;
         }
-        startY[9]=trans[9][1];
-        startX[13]=trans[13][0];
-        //velx[13]=velx[9]+prev*COR;
-        if(checkCollision(9,13))
+        startY[projectile]=trans[projectile][1];
+        startX[upperBlock]=trans[upperBlock][0];
+        //velx[upperBlock]=velx[projectile]+prev*COR;
+        if(checkCollision(projectile,upperBlock))
         {
-            velx[9]=((Mass[9]-COR*Mass[13])/(Mass[9]+Mass[13]))*prev;
-            velx[13]=COR*prev+velx[9];  
+            velx[projectile]=((Mass[projectile]-COR*Mass[upperBlock])/(Mass[projectile]+Mass[upperBlock]))*prev;
+            velx[upperBlock]=COR*prev+velx[projectile];  
         }
-        Timer[9]=tick;
-        Timer[13]=tick;
+        Timer[projectile]=tick;
+        Timer[upperBlock]=tick;
     }
-    if((velx[13]!=0.0f || vely[13]!=0.0f) && checkCollision(13,12))
+    if((velx[upperBlock]!=0.0f || vely[upperBlock]!=0.0f) && touching(upperBlock,12))
     {
-        if(trans[13][0]<120 && checkCollision(13,12))
-        {
-            velx[13]=-COR*xvel(velx[13],0.3f,Mass[13],Timer[13]);
-        }
-        while(trans[13][0]<120 && !checkCollision(13,12))
+        if(trans[upperBlock][0]<120 && checkCollision(upperBlock,12))
         {
-            trans[13][1]-=0.1f;;
+            velx[upperBlock]=-COR*xvel(velx[upperBlock],0.3f,Mass[upperBlock],Timer[upperBlock]);
         }
-        if(trans[13][0]>=120.0f && checkCollision(13,12))
+        if(trans[upperBlock][0]>=120.0f && checkCollision(upperBlock,12))
         {
-            velx[13]=COR*xvel(velx[13],0.3f,Mass[13],Timer[13]);
+            velx[upperBlock]=COR*xvel(velx[upperBlock],0.3f,Mass[upperBlock],Timer[upperBlock]);
         }
-        while(trans[13][0]>=120.0f && !checkCollision(13,12))
-        {
-            trans[13][1]-=1.0f;
-        }
-        startX[13]=trans[13][0];
-        startY[13]=trans[13][1];
-        Timer[13]=tick;
+        //Back down onto the lower block
+        dropOnto(upperBlock,12);
+        startX[upperBlock]=trans[upperBlock][0];
+        startY[upperBlock]=trans[upperBlock][1];
+        Timer[upperBlock]=tick;
     }
-    if((velx[13]!=0.0f || vely[13]!=0.0f) && checkCollision(13,1))
+    if((velx[upperBlock]!=0.0f || vely[upperBlock]!=0.0f) && touching(upperBlock,1))
     {
-        if(!checkCollision(13,12) && !checkCollision(13,0))
+        if(!checkCollision(upperBlock,12) && !checkCollision(upperBlock,0))
         {
-            trans[13][1]-=1.0f;
-            trans[13][0]-=1.0f;
+            trans[upperBlock][1]-=1.0f;
+            trans[upperBlock][0]-=1.0f;
         }
-        //velx[13]=-COR*xvel(velx[13],0.3f,Mass[13],Timer[13]);
-        //vely[13]=yvel(vely[13],0.3f,Mass[13],Timer[13],ADG);
-        //trans[13][0]=360.0f;
-        //startX[13]=trans[13][0];
-        //startY[13]=trans[13][1];
-        Timer[13]=tick;
+        //velx[upperBlock]=-COR*xvel(velx[upperBlock],0.3f,Mass[upperBlock],Timer[upperBlock]);
+        //vely[upperBlock]=yvel(vely[upperBlock],0.3f,Mass[upperBlock],Timer[upperBlock],ADG);
+        //trans[upperBlock][0]=360.0f;
+        //startX[upperBlock]=trans[upperBlock][0];
+        //startY[upperBlock]=trans[upperBlock][1];
+        Timer[upperBlock]=tick;
     }
 
     //Lower block fixed
-    if((velx[9]!=0.0f || vely[9]!=0.0f) && checkCollision(9,12))
+    if((velx[projectile]!=0.0f || vely[projectile]!=0.0f) && touching(projectile,12))
     {
-        if(trans[9][0]<120.0f && checkCollision(9,12))
+        if(trans[projectile][0]<120.0f && checkCollision(projectile,12))
         {
-            velx[9]=-COR*xvel(velx[9],0.3f,Mass[9],Timer[9]);
-            vely[9]=yvel(vely[9],0.3f,Mass[9],Timer[9],ADG);
+            velx[projectile]=-COR*xvel(velx[projectile],0.3f,Mass[projectile],Timer[projectile]);
+            vely[projectile]=yvel(vely[projectile],0.3f,Mass[projectile],Timer[projectile],ADG);
         }
-        else if(trans[9][0]==120.0f)
+        else if(trans[projectile][0]==120.0f)
         {
-            trans[9][0]=120.0f;
-            trans[9][1]=-220.0f;
+            trans[projectile][0]=120.0f;
+            trans[projectile][1]=-220.0f;
         }
-        else if(trans[9][0]>=160.0f && checkCollision(9,12))
+        else if(trans[projectile][0]>=160.0f && checkCollision(projectile,12))
         {
-            velx[9]=-COR*xvel(velx[9],0.3f,Mass[9],Timer[9]);
-            //velx[9]=-5.0f;
-            vely[9]=10.0f;
-            trans[9][0]=190.0f;
+            velx[projectile]=-COR*xvel(velx[projectile],0.3f,Mass[projectile],Timer[projectile]);
+            //velx[projectile]=-5.0f;
+            vely[projectile]=10.0f;
+            trans[projectile][0]=190.0f;
         }
-        while(trans[9][1]>=-250.0f && checkCollision(9,12))
+        if(trans[projectile][1]>=-250.0f && checkCollision(projectile,12))
         {
-            velx[9]=COR*xvel(velx[9],0.3f,Mass[9],Timer[9]);
-            //velx[9]=3.0f;
-            vely[9]=10.0f;
-            trans[9][1]=-210.0f;
+            velx[projectile]=COR*xvel(velx[projectile],0.3f,Mass[projectile],Timer[projectile]);
+            //velx[projectile]=3.0f;
+            vely[projectile]=10.0f;
+            trans[projectile][1]=-210.0f;
         }
-        startX[9]=trans[9][0];
-        startY[9]=trans[9][1];
-        Timer[9]=tick;
+        startX[projectile]=trans[projectile][0];
+        startY[projectile]=trans[projectile][1];
+        Timer[projectile]=tick;
     }
 
     //Pillar 2 fixed
-    if((velx[9]!=0.0f || vely[9]!=0.0f) && checkCollision(9,11))
+    if((velx[projectile]!=0.0f || vely[projectile]!=0.0f) && touching(projectile,11))
     {
-        velx[9]=-COR*xvel(velx[9],0.3f,Mass[9],Timer[9]);
-        vely[9]=yvel(vely[9],0.3f,Mass[9],Timer[9],ADG);
-        if(trans[9][0]<280)
+        velx[projectile]=-COR*xvel(velx[projectile],0.3f,Mass[projectile],Timer[projectile]);
+        vely[projectile]=yvel(vely[projectile],0.3f,Mass[projectile],Timer[projectile],ADG);
+        if(trans[projectile][0]<280)
         {
-            trans[9][0]=280.0f-touch;
+            trans[projectile][0]=280.0f-touch;
         }
-        if(trans[9][0]==280)
+        if(trans[projectile][0]==280)
         {
-            trans[9][0]=280.0f;
+            trans[projectile][0]=280.0f;
         }
-        if(trans[9][0]>280)
+        if(trans[projectile][0]>280)
         {
-            trans[9][0]=280.0f+touch;
+            trans[projectile][0]=280.0f+touch;
         }
-        startX[9]=trans[9][0];
-        startY[9]=trans[9][1];
-        Timer[9]=tick;
+        startX[projectile]=trans[projectile][0];
+        startY[projectile]=trans[projectile][1];
+        Timer[projectile]=tick;
     }
 
     //Pillar 3 fixed
-    if((velx[9]!=0.0f || vely[9]!=0.0f) && checkCollision(9,21))
+    if((velx[projectile]!=0.0f || vely[projectile]!=0.0f) && touching(projectile,21))
     {
-        velx[9]=-COR*xvel(velx[9],0.3f,Mass[9],Timer[9]);
-        vely[9]=yvel(vely[9],0.3f,Mass[9],Timer[9],ADG);
-        if(trans[9][0]<150)
+        velx[projectile]=-COR*xvel(velx[projectile],0.3f,Mass[projectile],Timer[projectile]);
+        vely[projectile]=yvel(vely[projectile],0.3f,Mass[projectile],Timer[projectile],ADG);
+        if(trans[projectile][0]<150)
         {
-            trans[9][0]=150.0f-touch;
+            trans[projectile][0]=150.0f-touch;
         }
-        if(trans[9][0]==150)
+        if(trans[projectile][0]==150)
         {
-            trans[9][0]=150.0f;
+            trans[projectile][0]=150.0f;
         }
-        if(trans[9][0]>150)
+        if(trans[projectile][0]>150)
         {
-            trans[9][0]=150.0f+touch;
+            trans[projectile][0]=150.0f+touch;
         }
-        startX[9]=trans[9][0];
-        startY[9]=trans[9][1];
-        Timer[9]=tick;
+        startX[projectile]=trans[projectile][0];
+        startY[projectile]=trans[projectile][1];
+        Timer[projectile]=tick;
     }
 
     //Pillar 4 fixed
-    if((velx[9]!=0.0f || vely[9]!=0.0f) && checkCollision(9,22))
+    if((velx[projectile]!=0.0f || vely[projectile]!=0.0f) && touching(projectile,22))
     {
-        velx[9]=xvel(velx[9],0.3f,Mass[9],Timer[9]);
-        vely[9]=-COR*yvel(vely[9],0.3f,Mass[9],Timer[9],ADG);
-        if(trans[9][1]<trans[22][1] && checkCollision(9,22))
+        velx[projectile]=xvel(velx[projectile],0.3f,Mass[projectile],Timer[projectile]);
+        vely[projectile]=-COR*yvel(vely[projectile],0.3f,Mass[projectile],Timer[projectile],ADG);
+        if(trans[projectile][1]<trans[22][1] && checkCollision(projectile,22))
         {
-            //cout << "bhajesh " << trans[9][1] << " " << trans[22][1] << endl;
-            trans[9][1]=-touch;
-            velx[9]=0.0f;
-            vely[9]=0.0f;
-            Timer[9]=0.0f;
+            //cout << "bhajesh " << trans[projectile][1] << " " << trans[22][1] << endl;
+            trans[projectile][1]=-touch;
+            velx[projectile]=0.0f;
+            vely[projectile]=0.0f;
+            Timer[projectile]=0.0f;
         }
         else
         {
-            trans[9][1]=touch;
-            startX[9]=trans[9][0];
-            startY[9]=trans[9][1];
-            Timer[9]=tick;
+            trans[projectile][1]=touch;
+            startX[projectile]=trans[projectile][0];
+            startY[projectile]=trans[projectile][1];
+            Timer[projectile]=tick;
         }
     }
+    endPass(passCollisions);
+}
+
+//Profiler bar graph in the top right corner : a row per pass with its last 60 frames, CPU time
+//up from the row's axis and GPU time down from it, 10 pixels a millisecond up to 2 ms
+void drawProfileOverlay()
+{
+    const int history=60;
+    float left=camera.ortho[1]-10.0f-2*history;
+    for(int p=0;p<profiler.numPasses;p++)
+    {
+        const ProfilePass& pass=profiler.passes[p];
+        float y=camera.ortho[3]-110.0f-p*45.0f;
+        //strokes[6] runs from -Lx to Lx along the x axis
+        queueObject(strokes[6],glm::translate(glm::vec3(left+history,y,0))*glm::scale(glm::vec3(history/Lx,1,1)));
+        //Name and last CPU time left of the row
+        char label[32];
+        int last=(profiler.frame+PROFILE_FRAMES-1)%PROFILE_FRAMES;
+        int n=snprintf(label,sizeof(label),"%s %.2f",pass.name,pass.cpu[last]);
+        glm::vec2 at=worldToPixel(left,y);
+        queueText(at.x-n*TEXT_GLYPH-6,at.y-TEXT_GLYPH/2,label,1,0,0,0);
+        for(int k=0;k<history;k++)
+        {
+            int f=profiler.frame-history+k;
+            if(f<0)
+                continue;
+            float ms[]={(float)pass.cpu[f%PROFILE_FRAMES],(float)pass.gpuTime[f%PROFILE_FRAMES]};
+            for(int side=0;side<2;side++)
+            {
+                float h=ms[side]*10.0f;
+                if(h>20.0f)
+                    h=20.0f;
+                if(h<=0.0f)
+                    continue;
+                //strokes[1] runs from (-Lx,0) up to (-Lx,Ly)
+                queueObject(strokes[1],glm::translate(glm::vec3(left+2*k+Lx,y,0))*glm::scale(glm::vec3(1,(side ? -h : h)/Ly,1)));
+            }
+        }
+    }
+}
+
+void draw()
+{
+    TRACE_SCOPE("draw");
+    beginProfileFrame();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    pollShaderReload(); //-hot-reload : rebuilt first if the shader files changed
+    glUseProgram (programID);
+    //Only marks the camera dirty when pan or zoom changed
+    setOrtho(-(zoomX/2.0f)+panX,(zoomX/2.0f)+panX,-(zoomY/2.0f)+panY,(zoomY/2.0f)+panY,0.1f, 500.0f);
+    //queueText(100, 100, message, 1, 0, 0, 0);
+    //queueText(50, 145, "(positioned in pixels with upper-left origin)", 1, 0, 0, 0);
+    //Drawing objects
+    //Run the physics steps that are due, however long the last frame took
+    int steps=stepsDue(simClock,frameTime());
+    for(int s=0;s<steps;s++)
+    {
+        beginStep(bodies);
+        stepSimulation();
+        endStep(bodies);
+    }
+    beginPass(passWorld);
 
     //power background
     drawobject(objects[23],trans[23],rotat[23],glm::vec3(0,0,1));   
@@ -789,81 +838,63 @@ void draw()
     //Left Wall
     drawobject(objects[3],trans[3],rotat[3],glm::vec3(0,0,1));   
     //Sun
-    for(int i=0;i<20;i+=2)
-    {
-        drawobject(objects[25],trans[25],i*20,glm::vec3(0,0,1));   
-    }
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[24],trans[24],i*20,glm::vec3(0,0,1));   
-    }
+    drawobject(objects[25],trans[25],rotat[25],glm::vec3(0,0,1));   
+    drawobject(objects[24],trans[24],rotat[24],glm::vec3(0,0,1));   
 
     //Cannon
     //Circle
-    for(int i=1;i<20;i++)
-    {
-        drawobject(objects[4],trans[4],i*20,glm::vec3(0,0,1));   
-    }
+    drawobject(objects[4],trans[4],rotat[4],glm::vec3(0,0,1));   
     //Rectangle
     drawobject(objects[5],trans[5],rotat[5],glm::vec3(0,0,1));   
     //Circle
-    for(int i=1;i<20;i++)
-    {
-        drawobject(objects[6],trans[6],i*20,glm::vec3(0,0,1));   
-    }
+    drawobject(objects[6],trans[6],rotat[6],glm::vec3(0,0,1));   
     //Tank Head
-    for(int i=1;i<20;i++)
-    {
-        drawobject(objects[7],trans[7],i*20,glm::vec3(0,0,1));   
-    }
+    drawobject(objects[7],trans[7],rotat[7],glm::vec3(0,0,1));   
     //Barrel
     rotateBarrel=atan2((-ymousepos+300-trans[7][1]),(xmousepos-400-trans[7][0]))*(180/M_PI);
     trans[8][0]=trans[7][0]+50*cos(rotateBarrel*(M_PI/180));
     trans[8][1]=trans[7][1]+50*sin(rotateBarrel*(M_PI/180));
     drawobject(objects[8],trans[8],rotateBarrel,glm::vec3(0,0,1));
-    //Projectile
-    for(int i=1;i<360;i++)
-    {
-        drawobject(objects[9],trans[9],i,glm::vec3(0,0,1));   
-    }
-    for(int i=1;i<18;i++)
+    //Aim preview, from where the shot starts at the speed a click fires it at, rebuilt only when the aim moves
+    if(buttonPressed==0)
     {
-        drawobject(objects[26],trans[26],i*10,glm::vec3(0,0,1));   
+        float launch=30*(xmousepos/400);
+        updateTrajectoryPreview(aimPreview,bodies,projectile,collisionGrid,-314+speed*cos(D2R(rotateBarrel)),-190+speed*sin(D2R(rotateBarrel)),
+                                launch*cos(D2R(rotateBarrel)),launch*sin(D2R(rotateBarrel)),ADG,stopsPreview);
+        drawobject(aimPreview.vao,glm::vec3(0,0,0),0,glm::vec3(0,0,1));
     }
+    //Projectile
+    drawobject(objects[projectile],renderPosition(bodies,projectile,simClock.alpha),rotat[projectile],glm::vec3(0,0,1));   
+    drawobject(objects[26],trans[26],rotat[26],glm::vec3(0,0,1));   
     //Pillar 3
     drawobject(objects[21],trans[21],rotat[21],glm::vec3(0,0,1));
     //Pillar94
     drawobject(objects[22],trans[22],rotat[22],glm::vec3(0,0,1));
     //Power up
-    if(!checkCollision(9,28) && !vanish)
+    if(!touching(projectile,28) && !vanish)
     {
-        for(int i=0;i<20;i++)
-        {
-            drawobject(objects[28],trans[28],i*20,glm::vec3(0,0,1));
-        }
+        drawobject(objects[28],trans[28],rotat[28],glm::vec3(0,0,1));
     }
-    if(!checkCollision(9,29) && !vanish1)
+    if(!touching(projectile,29) && !vanish1)
     {
-        for(int i=0;i<20;i++)
-        {
-            drawobject(objects[29],trans[29],i*20,glm::vec3(0,0,1));
-        }
+        drawobject(objects[29],trans[29],rotat[29],glm::vec3(0,0,1));
     }
-    if(checkCollision(9,29) && radius==15)
+    if(touching(projectile,29) && radius==15)
     {
         vanish1=true;
         radius=10.0f;
     }
-    if(checkCollision(9,28))
+    if(touching(projectile,28))
     {
         vanish=true;
         radius=15.0f;
     }
     if(vanish1)
     {
-        objects[9]=createSector(radius,18,blueblack);
+        //Cached, so this is only built the first frame
+        objects[projectile]=createArc(radius,18,1,359,1,blueblack);
         trans[29]=glm::vec3(800.0f,500.0f,0.0f);
-        centre[9].pb(mp(mp(0.0f,0.0f),radius));
+        centre[projectile].assign(1,mp(mp(0.0f,0.0f),radius));
         touch=20.0f;
         if(flag1==0)
         {
@@ -873,29 +904,29 @@ void draw()
     }
     if(vanish)
     {
-        objects[9]=createSector(radius,18,blueblack);
+        objects[projectile]=createArc(radius,18,1,359,1,blueblack);
         if(flag==0)
         {
             score+=20;
         }
         trans[28]=glm::vec3(800.0f,500.0f,0.0f);
-        centre[9].pb(mp(mp(0.0f,0.0f),radius));
+        centre[projectile].assign(1,mp(mp(0.0f,0.0f),radius));
         touch=40.0f;
         flag=1;
     }
     //Most of the drawing
-    if(checkCollision(20,10) && piggy)
+    if(touching(20,10) && piggy)
     {
         piggy=false;
         score+=40;
     }
-    if(checkCollision(9,10))
+    if(touching(projectile,10))
     {
         count[10]+=1;
     }
     if(rodscore)
     {
-        if(checkCollision(9,10))
+        if(checkCollision(projectile,10))
         {
             score+=10;
             rodscore=false;
@@ -923,125 +954,68 @@ void draw()
         {
             if(count[i]<3 && i<15)
             {
-                drawobject(objects[i],trans[i],rotat[i],glm::vec3(0,0,1));
+                drawobject(objects[i],renderPosition(bodies,i,simClock.alpha),rotat[i],glm::vec3(0,0,1));
             }
             if(count[i]>=3)
             {            
                 trans[i]=glm::vec3(-400.0f,-300.0f,0.0f);
             }
-            //Pigs
-            if(piggy)
-            {
-                for(int i=1;i<20;i++)
-                {
-                    drawobject(objects[15],trans[15],i*20,glm::vec3(0,0,1));   
-                }
-                for(int i=1;i<20;i++)
-                {
-                    drawobject(objects[16],trans[16],i*20,glm::vec3(0,0,1));   
-                }
-                for(int i=1;i<20;i++)
-                {
-                    drawobject(objects[17],trans[17],i*20,glm::vec3(0,0,1));   
-                }
-                for(int i=1;i<20;i++)
-                {
-                    drawobject(objects[18],trans[18],i*20,glm::vec3(0,0,1));   
-                }
-                for(int i=1;i<20;i++)
-                {
-                    drawobject(objects[19],trans[19],i*20,glm::vec3(0,0,1));   
-                }
-                for(int i=1;i<20;i++)
-                {
-                    drawobject(objects[20],trans[20],i*20,glm::vec3(0,0,1));   
-                }
-            }
+        }
+    }
+    //Pigs, drawn once on top of the blocks
+    if(piggy)
+    {
+        for(int i=15;i<21;i++)
+        {
+            drawobject(objects[i],renderPosition(bodies,i,simClock.alpha),rotat[i],glm::vec3(0,0,1));   
         }
     }
     //Inner Lower block
     drawobject(objects[27],trans[27],rotat[27],glm::vec3(0,0,1));
     //Inner Sun
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[30],trans[30],i*20,glm::vec3(0,0,1));
-    }
-    //Cloud
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[31],glm::vec3(-130,130,0),i*20,glm::vec3(0,0,1));
-    }
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[31],glm::vec3(-120,110,0),i*20,glm::vec3(0,0,1));
-    }
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[31],glm::vec3(-100,140,0),i*20,glm::vec3(0,0,1));
-    }
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[31],glm::vec3(-90,100,0),i*20,glm::vec3(0,0,1));
-    }
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[31],glm::vec3(-70,145,0),i*20,glm::vec3(0,0,1));
-    }
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[31],glm::vec3(-66,100,0),i*20,glm::vec3(0,0,1));
-    }
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[31],glm::vec3(-40,145,0),i*20,glm::vec3(0,0,1));
-    }
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[31],glm::vec3(-35,110,0),i*20,glm::vec3(0,0,1));
-    }
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[31],glm::vec3(-15,135,0),i*20,glm::vec3(0,0,1));
-    }
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[31],glm::vec3(-65,130,0),i*20,glm::vec3(0,0,1));
-    }
-    for(int i=0;i<20;i++)
-    {
-        drawobject(objects[31],glm::vec3(-85,130,0),i*20,glm::vec3(0,0,1));
-    }
+    drawobject(objects[30],trans[30],rotat[30],glm::vec3(0,0,1));
+    //Cloud, every puff is an instance
+    drawobject(objects[31],glm::vec3(0,0,0),rotat[31],glm::vec3(0,0,1));
     //Inner Floor
     drawobject(objects[32],trans[32],rotat[32],glm::vec3(0,0,1));
     //Top rectangle
     drawobject(objects[33],trans[33],rotat[33],glm::vec3(0,0,1));
-    //Text
-    stringstream ss;
-    ss << score;
-    string text="score"+ss.str();
-    for(int i=0;i<5;i++)
+    flushRenderQueue();
+    endPass(passWorld);
+    //Text, over the world
+    beginPass(passText);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    //The score's segments are rebuilt only when it changes, and drawn in one call
+    if(score!=shownScore || !scoreText.vao)
     {
-        toBits(value[text[i]]);
-        for(int j=0;j<8;j++)
-        {
-            if(ok[j])
-            {
-                drawobject(strokes[j],glm::vec3(100.0f+i*(2*Lx+5),235.0f,0),0,glm::vec3(0,0,1));
-            }
-        }
+        char text[32];
+        snprintf(text,sizeof(text),"score%d",score);
+        setSegmentText(scoreText,text);
+        shownScore=score;
     }
-    for(int i=5;i<text.length();i++)
+    if(scoreText.vao->NumVertices>0)
     {
-        toBits(value[text[i]]);
-        for(int j=0;j<8;j++)
-        {
-            if(ok[j])
-            {
-                drawobject(strokes[j],glm::vec3(100.0f+i*(2*Lx+5),235.0f,0),0,glm::vec3(0,0,1));
-            }
-        }
+        drawobject(scoreText.vao,glm::vec3(100.0f,235.0f,0),0,glm::vec3(0,0,1));
+    }
+    if(profiler.overlay)
+    {
+        drawProfileOverlay();
+    }
+    //Name in the top border
+    queueText(24,2,"Varshit",2,255,255,255);
+    flushRenderQueue();
+    flushText();
+    endPass(passText);
+    beginPass(passSwap);
+    if(offscreenFrame<0)
+    {
+        TRACE_SCOPE("glutSwapBuffers");
+        glutSwapBuffers ();
     }
-    glutSwapBuffers ();
+    endPass(passSwap);
+    endProfileFrame();
+    TRACE_COUNTER("checkCollision", collisionChecks);
+    collisionChecks=0;
 }
 
 void idle()
@@ -1079,9 +1053,14 @@ void initGLUT(int& argc, char** argv, int width, int height)
 
 VAO* createTriangle(float X1,float Y1,float X2,float Y2,float X3,float Y3)
 {
+    float params[]={X1,Y1,X2,Y2,X3,Y3};
+    string key=meshKey("triangle",params,6);
+    if(VAO* mesh=findMesh(key))
+        return mesh;
     GLfloat vertex_buffer_data[]={X1,Y1,0.0f,X2,Y2,0.0f,X3,Y3,0.0f};
     GLfloat color_buffer_data[]={1,0,0,1,0,0,1,0,0};
-    return create3DObject(GL_TRIANGLES,3,vertex_buffer_data,color_buffer_data,GL_FILL);
+    std::vector<Vertex> vertices=packVertices(3,vertex_buffer_data,color_buffer_data);
+    return cacheMesh(key,createPooledObject(GL_TRIANGLES,3,&vertices[0],0,NULL,GL_FILL));
 }
 
 void divideRect(int i,float width,float height)
@@ -1096,8 +1075,20 @@ void divideRect(int i,float width,float height)
     }
 }
 
+//Uniform handles and camera block of the scene program, again for each reloaded one
+void setupProgram(GLuint program)
+{
+    Matrices.MatrixID = glGetUniformLocation(program, "Model");
+    bindCameraBlock(program);
+}
+
 void initGL(int width, int height)
 {
+    TRACE_SCOPE("initGL");
+    //Bodies, numbered as in the drawing code
+    for(int i=0;i<SCENE_BODIES;i++)
+        createBody(bodies);
+    objects.resize(bodyCount(bodies));
     //Colours
 
     float r,g,b;
@@ -1137,6 +1128,7 @@ void initGL(int width, int height)
     trans[0]=glm::vec3(0.0f,-290.0f,0.0f);
     rotat[0]=0.0f;
     movable[0]=false;
+    solid[0]=true;
     //Lower Floor
     objects[32]=createRectangle(380.0f,9.0f,lighestgreen);
     divideRect(32,400.0f,10.0f);
@@ -1149,6 +1141,7 @@ void initGL(int width, int height)
     trans[1]=glm::vec3(390.0f,0.0f,0.0f);
     rotat[1]=90.0f;
     movable[1]=false;
+    solid[1]=true;
     //Top wall 
     objects[2]=createRectangle(400.0f,10.0f,blue);
     divideRect(2,400.0f,10.0f);
@@ -1161,10 +1154,11 @@ void initGL(int width, int height)
     trans[3]=glm::vec3(-390.0f,0.0f,0.0f);
     rotat[3]=-90.0f;
     movable[3]=false;
+    solid[3]=true;
 
     //Cannon
     //Circle
-    objects[4]=createSector(20,18,blueblack);
+    objects[4]=createDisc(20,18,blueblack);
     trans[4]=glm::vec3(-340.0f,-260.0f,0.0f);
     rotat[4]=0.0f;
     movable[4]=false;
@@ -1181,13 +1175,13 @@ void initGL(int width, int height)
     movable[33]=false;
 
     //Circle
-    objects[6]=createSector(20,18,blueblack);
+    objects[6]=createDisc(20,18,blueblack);
     trans[6]=glm::vec3(-295.0f,-260.0f,0.0f);
     rotat[6]=0.0f;
     movable[6]=false;
 
     //Tank Head
-    objects[7]=createSector(35,18,blueblack);
+    objects[7]=createDisc(35,18,blueblack);
     trans[7]=glm::vec3(-317.0f,-190.0f,0.0f);
     rotat[7]=0.0f;
     movable[7]=false;
@@ -1199,13 +1193,13 @@ void initGL(int width, int height)
     movable[8]=false;
 
     //Projectile
-    objects[9]=createSector(radius,18,blueblack);
-    centre[9].pb(mp(mp(0.0f,0.0f),radius));
-    Mass[9]=250.0f;
-    velx[9]=vely[9]=0.0f;
-    trans[9]=glm::vec3(0.0f,0.0f,0.0f);
-    rotat[9]=0.0f;
-    movable[9]=true;
+    objects[projectile]=createArc(radius,18,1,359,1,blueblack);
+    centre[projectile].pb(mp(mp(0.0f,0.0f),radius));
+    Mass[projectile]=250.0f;
+    velx[projectile]=vely[projectile]=0.0f;
+    trans[projectile]=glm::vec3(0.0f,0.0f,0.0f);
+    rotat[projectile]=0.0f;
+    movable[projectile]=true;
 
     //Pillar 1
     objects[10]=createRectangle(50,10,darkbrown);
@@ -1224,6 +1218,7 @@ void initGL(int width, int height)
     trans[11]=glm::vec3(280.0f,40.0f,0.0f);
     rotat[11]=90.0f;
     movable[11]=false;
+    solid[11]=true;
 
     //Pillar 3
     objects[21]=createRectangle(50,10,darkbrown);
@@ -1233,6 +1228,7 @@ void initGL(int width, int height)
     trans[21]=glm::vec3(150.0f,40.0f,0.0f);
     rotat[21]=90.0f;
     movable[21]=false;
+    solid[21]=true;
 
     //Pillar 4
     objects[22]=createRectangle(70,10,darkbrown);
@@ -1242,6 +1238,7 @@ void initGL(int width, int height)
     trans[22]=glm::vec3(220.0f,0.0f,0.0f);
     rotat[22]=0.0f;
     movable[22]=false;
+    solid[22]=true;
 
     //Lower block
     objects[12]=createRectangle(60,30,lightbrown);
@@ -1251,6 +1248,7 @@ void initGL(int width, int height)
     velx[12]=vely[12]=0.0f;
     rotat[12]=0.0f;
     movable[12]=false;
+    solid[12]=true;
 
     //Inner Lower Block
     objects[27]=createRectangle(55,25,darkbrown);
@@ -1262,13 +1260,13 @@ void initGL(int width, int height)
     movable[27]=false;
 
     //Upper block
-    objects[13]=createRectangle(40,20,lightbrown);
-    divideRect(13,40.0f,20.0f);
-    Mass[13]=450.0f;
-    velx[13]=vely[13]=0.0f;
-    trans[13]=glm::vec3(120.0f,-190.0f,0.0f);
-    rotat[13]=90.0f;
-    movable[13]=true;
+    objects[upperBlock]=createRectangle(40,20,lightbrown);
+    divideRect(upperBlock,40.0f,20.0f);
+    Mass[upperBlock]=450.0f;
+    velx[upperBlock]=vely[upperBlock]=0.0f;
+    trans[upperBlock]=glm::vec3(120.0f,-190.0f,0.0f);
+    rotat[upperBlock]=90.0f;
+    movable[upperBlock]=true;
 
     //Health Bar
     objects[14]=createRectangle(10,20,green);
@@ -1282,7 +1280,7 @@ void initGL(int width, int height)
     rotat[23]=0.0f;
     movable[32]=false;
     //Pigs
-    objects[15]=createSector(25.0f,18,green);
+    objects[15]=createDisc(25.0f,18,green);
     centre[15].pb(mp(mp(0.0f,0.0f),25.0f));
     Mass[15]=250.0f;
     velx[15]=vely[15]=0.0f;
@@ -1290,7 +1288,7 @@ void initGL(int width, int height)
     rotat[15]=0.0f;
     movable[15]=false;
     //Pig Eye1
-    objects[16]=createSector(4.0f,18,blue);
+    objects[16]=createDisc(4.0f,18,blue);
     centre[16].pb(mp(mp(0.0f,0.0f),4.0f));
     Mass[16]=250.0f;
     velx[16]=vely[16]=0.0f;
@@ -1298,7 +1296,7 @@ void initGL(int width, int height)
     rotat[16]=0.0f;
     movable[16]=false;
     //Pig Eye2
-    objects[17]=createSector(4.0f,18,blue);
+    objects[17]=createDisc(4.0f,18,blue);
     centre[17].pb(mp(mp(0.0f,0.0f),4.0f));
     Mass[17]=250.0f;
     velx[17]=vely[17]=0.0f;
@@ -1306,7 +1304,7 @@ void initGL(int width, int height)
     rotat[17]=0.0f;
     movable[17]=false;
     //Pig nose
-    objects[18]=createSector(8.0f,18,blue);
+    objects[18]=createDisc(8.0f,18,blue);
     centre[18].pb(mp(mp(0.0f,0.0f),8.0f));
     Mass[18]=250.0f;
     velx[18]=vely[18]=0.0f;
@@ -1314,7 +1312,7 @@ void initGL(int width, int height)
     rotat[18]=0.0f;
     movable[18]=false;
     //Pig ear 1
-    objects[19]=createSector(12.0f,18,green);
+    objects[19]=createDisc(12.0f,18,green);
     centre[19].pb(mp(mp(0.0f,0.0f),12.0f));
     Mass[19]=250.0f;
     velx[19]=vely[19]=0.0f;
@@ -1322,7 +1320,7 @@ void initGL(int width, int height)
     rotat[19]=0.0f;
     movable[19]=true;
     //Pig ear 2
-    objects[20]=createSector(12.0f,18,green);
+    objects[20]=createDisc(12.0f,18,green);
     centre[20].pb(mp(mp(0.0f,0.0f),12.0f));
     Mass[20]=250.0f;
     velx[20]=vely[20]=0.0f;
@@ -1331,7 +1329,7 @@ void initGL(int width, int height)
     movable[20]=false;
 
     //Sun
-    objects[24]=createSector(40.0f,18,yellow);
+    objects[24]=createDisc(40.0f,18,yellow);
     centre[24].pb(mp(mp(0.0f,0.0f),40.0f));
     Mass[24]=250.0f;
     velx[24]=vely[24]=0.0f;
@@ -1339,7 +1337,7 @@ void initGL(int width, int height)
     rotat[24]=0.0f;
     movable[24]=false;
     //Inner Sun
-    objects[30]=createSector(35.0f,18,lightorange);
+    objects[30]=createDisc(35.0f,18,lightorange);
     centre[30].pb(mp(mp(0.0f,0.0f),35.0f));
     Mass[30]=250.0f;
     velx[30]=vely[30]=0.0f;
@@ -1347,7 +1345,7 @@ void initGL(int width, int height)
     rotat[30]=0.0f;
     movable[30]=false;
     //Sun shade
-    objects[25]=createSector(60.0f,25,lightyellow);
+    objects[25]=createArc(60.0f,25,0.0f,320.0f,40.0f,lightyellow);
     centre[25].pb(mp(mp(0.0f,0.0f),60.0f));
     Mass[25]=250.0f;
     velx[25]=vely[25]=0.0f;
@@ -1355,7 +1353,7 @@ void initGL(int width, int height)
     rotat[25]=0.0f;
     movable[25]=false;
     //Inner tank head
-    objects[26]=createSector(30.0f,18,lightblue);
+    objects[26]=createArc(30.0f,18,10.0f,170.0f,10.0f,lightblue);
     centre[26].pb(mp(mp(0.0f,0.0f),30.0f));
     Mass[26]=250.0f;
     velx[26]=vely[26]=0.0f;
@@ -1364,7 +1362,7 @@ void initGL(int width, int height)
     movable[26]=false;
 
     //Power up 
-    objects[28]=createSector(30.0f,18,redgreen);
+    objects[28]=createDisc(30.0f,18,redgreen);
     centre[28].pb(mp(mp(0.0f,0.0f),0.0f));
     Mass[28]=250.0f;
     velx[28]=vely[28]=0.0f;
@@ -1373,7 +1371,7 @@ void initGL(int width, int height)
     movable[28]=false;
 
     //Power down
-    objects[29]=createSector(30.0f,18,bluegreen);
+    objects[29]=createDisc(30.0f,18,bluegreen);
     centre[29].pb(mp(mp(0.0f,0.0f),30.0f));
     Mass[29]=250.0f;
     velx[29]=vely[28]=0.0f;
@@ -1392,7 +1390,8 @@ void initGL(int width, int height)
     strokes[7]=createLine(0.0f,0.0f,Lx,-Ly);
     
     //Cloud 
-    objects[31]=createSector(20.0f,18,lighestblue);
+    float puffs[][2]={{-130,130},{-120,110},{-100,140},{-90,100},{-70,145},{-66,100},{-40,145},{-35,110},{-15,135},{-65,130},{-85,130}};
+    objects[31]=createCloud(20.0f,18,puffs,11,lighestblue);
     centre[31].pb(mp(mp(0.0f,0.0f),20.0f));
     Mass[31]=250.0f;
     velx[31]=vely[31]=0.0f;
@@ -1401,8 +1400,18 @@ void initGL(int width, int height)
     movable[31]=false;
 
     //Functionality
-    programID=LoadShaders("Sample_GL.vert","Sample_GL.frag");
-    Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+    //Every program compiles and links at once
+    addShaderProgram(&programID,"Sample_GL.vert","Sample_GL.frag",setupProgram);
+    initText();
+    if(!buildShaderPrograms())
+        exit(1);
+    if(shaderReload.enabled)
+        startShaderReload();
+    passPhysics=profilePass("physics",false);
+    passCollisions=profilePass("collisions",false);
+    passWorld=profilePass("world",true);
+    passText=profilePass("text",true);
+    passSwap=profilePass("swap",true);
     reshapeWindow (width, height);
     GLfloat skyblue[]={0.0,1.0,1.0,0.0,1.0,1.0,0.0,1.0,1.0,0.0,1.0,1.0,0.0,1.0,1.0,0.0,1.0,1.0};
     glClearColor (0.0f, 1.0f, 1.0f, 0.0f);
@@ -1415,28 +1424,86 @@ int main (int argc, char** argv)
 {
     width = 800;
     height = 600;
-    initGLUT (argc, argv, width, height);
-    initGL(width, height);
-    value['0']=63; 
-    value['1']=48; 
-    value['2']=109; 
-    value['3']=121; 
-    value['4']=114; 
-    value['5']=91; 
-    value['6']=95; 
-    value['7']=49; 
-    value['8']=127; 
-    value['9']=123; 
-    value['s']=91; 
-    value['c']=15; 
-    value['o']=63; 
-    value['r']=231; 
-    value['e']=79;
+    int frames = 0;            //-offscreen N : render N frames with no window
+    bool profileAfter = false; //-profile file.csv : where 'o' and the end of an offscreen run write the profile
+    const char* out = "frame"; //-out prefix : written as prefix_0000.ppm, ...
+    const char* format = "ppm"; //-png : write PNG instead
+    const char* tracePath = NULL; //-trace file.json : record a Chrome trace, written at exit
     for (int i = 1; i < argc; i++) {
-        if (!strcmp(argv[i], "-mono")) {
-            font = GLUT_BITMAP_9_BY_15;
+        if (!strcmp(argv[i], "-hz") && i+1 < argc) {
+            simClock.rate = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-speed") && i+1 < argc) {
+            simClock.timeScale = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-offscreen") && i+1 < argc) {
+            frames = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-out") && i+1 < argc) {
+            out = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-png")) {
+            format = "png";
+        }
+        else if (!strcmp(argv[i], "-profile") && i+1 < argc) {
+            profilePath = argv[++i];
+            profileAfter = true;
+        }
+        else if (!strcmp(argv[i], "-overlay")) {
+            profiler.overlay = true;
+        }
+        else if (!strcmp(argv[i], "-trace") && i+1 < argc) {
+            tracePath = argv[++i];
         }
+        else if (!strcmp(argv[i], "-shaders") && i+1 < argc) {
+            shaderDirectory = argv[++i]; //-shaders dir : read the shaders from dir, not the built in copies
+        }
+        else if (!strcmp(argv[i], "-hot-reload")) {
+            shaderReload.enabled = true; //Rebuild the shaders when their files change, from -shaders or here
+        }
+    }
+    if (shaderReload.enabled && !shaderDirectory) {
+        shaderDirectory = ".";
+    }
+    if (tracePath) {
+        startTrace(tracePath);
+    }
+    if (simClock.rate <= 0) {
+        simClock.rate = 60.0f;
+    }
+    if (frames > 0) {
+        if (!createOffscreenContext())
+            exit (1);
+        glewExperimental = GL_TRUE;
+        GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+        //A GLEW built for GLX loads the core and extension entry points, then fails looking for
+        //a GLX display, which an EGL context without X does not have. Nothing here needs GLX.
+        if (err == GLEW_ERROR_NO_GLX_DISPLAY)
+            err = GLEW_OK;
+#endif
+        if (err != GLEW_OK)
+        {
+            cout << "Error: Failed to initialise GLEW : "<< glewGetErrorString(err) << endl;
+            exit (1);
+        }
+        if (!createOffscreenFramebuffer(width, height))
+            exit (1);
+        initGL(width, height);
+        for (offscreenFrame = 0; offscreenFrame < frames; offscreenFrame++) {
+            draw();
+            char path[1024];
+            snprintf(path, sizeof(path), "%s_%04d.%s", out, offscreenFrame, format);
+            if (!writeFrame(path))
+                exit (1);
+        }
+        if (profileAfter)
+            dumpProfile(profilePath);
+        clearMeshCache();
+        return 0;
     }
+    initGLUT (argc, argv, width, height);
+    initGL(width, height);
     glutMainLoop ();
     return 0;
 }
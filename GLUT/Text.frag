@@ -0,0 +1,17 @@
+#version 330 core
+
+in vec2 fragUV;
+in vec3 fragColor;
+
+// One channel font atlas, lit texels are 1
+uniform sampler2D Atlas;
+
+out vec3 color;
+
+void main()
+{
+    // Only the glyph's own pixels are drawn, so no blending is needed
+    if (texture(Atlas, fragUV).r < 0.5)
+        discard;
+    color = fragColor;
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+// Glyph quads from bitmaptext.h, in pixels from the top left corner of the viewport
+layout (location = 0) in vec2 vertexPosition;
+// position in the font atlas
+layout (location = 1) in vec2 vertexUV;
+layout (location = 2) in vec3 vertexColor;
+
+// Viewport size in pixels
+uniform vec2 Viewport;
+
+out vec2 fragUV;
+out vec3 fragColor;
+
+void main ()
+{
+    fragUV = vertexUV;
+    fragColor = vertexColor;
+
+    // Pixels to clip space, y down
+    gl_Position = vec4(2 * vertexPosition.x / Viewport.x - 1, 1 - 2 * vertexPosition.y / Viewport.y, 0, 1);
+}
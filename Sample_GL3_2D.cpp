@@ -1,5 +1,7 @@
 #include <iostream>
 #include <cmath>
+#include <cctype>
+#include <cstring>
 #include <fstream>
 #include <vector>
 
@@ -12,105 +14,23 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-using namespace std;
-
-struct VAO {
-    GLuint VertexArrayID;
-    GLuint VertexBuffer;
-    GLuint ColorBuffer;
-
-    GLenum PrimitiveMode;
-    GLenum FillMode;
-    int NumVertices;
-};
-typedef struct VAO VAO;
+#include "render.h"
+#include "physics.h"
+#include "simulation.h"
+#include "offscreen.h"
+#include "bench.h"
+#include "shadercache.h"
+#include "shadersource.h"
+#include "embedded_shaders.h"
+#include "shaderprograms.h"
+#include "hotreload.h"
+#include "bitmaptext.h"
+#include "trajectorypreview.h"
 
-struct GLMatrices {
-    glm::mat4 projection;
-    glm::mat4 model;
-    glm::mat4 view;
-    GLuint MatrixID;
-} Matrices;
+using namespace std;
 
 GLuint programID;
 
-/* Function to load Shaders - Use it as it is */
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
-
-    // Create the shaders
-    GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-    GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
-    // Read the Vertex Shader code from the file
-    std::string VertexShaderCode;
-    std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-    if(VertexShaderStream.is_open())
-    {
-        std::string Line = "";
-        while(getline(VertexShaderStream, Line))
-            VertexShaderCode += "\n" + Line;
-        VertexShaderStream.close();
-    }
-
-    // Read the Fragment Shader code from the file
-    std::string FragmentShaderCode;
-    std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-    if(FragmentShaderStream.is_open()){
-        std::string Line = "";
-        while(getline(FragmentShaderStream, Line))
-            FragmentShaderCode += "\n" + Line;
-        FragmentShaderStream.close();
-    }
-
-    GLint Result = GL_FALSE;
-    int InfoLogLength;
-
-    // Compile Vertex Shader
-    printf("Compiling shader : %s\n", vertex_file_path);
-    char const * VertexSourcePointer = VertexShaderCode.c_str();
-    glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-    glCompileShader(VertexShaderID);
-
-    // Check Vertex Shader
-    glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-    glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-    std::vector<char> VertexShaderErrorMessage(InfoLogLength);
-    glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-    fprintf(stdout, "%s\n", &VertexShaderErrorMessage[0]);
-
-    // Compile Fragment Shader
-    printf("Compiling shader : %s\n", fragment_file_path);
-    char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-    glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-    glCompileShader(FragmentShaderID);
-
-    // Check Fragment Shader
-    glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-    glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-    std::vector<char> FragmentShaderErrorMessage(InfoLogLength);
-    glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-    fprintf(stdout, "%s\n", &FragmentShaderErrorMessage[0]);
-
-    // Link the program
-    fprintf(stdout, "Linking program\n");
-    GLuint ProgramID = glCreateProgram();
-    glAttachShader(ProgramID, VertexShaderID);
-    glAttachShader(ProgramID, FragmentShaderID);
-    glLinkProgram(ProgramID);
-
-    // Check the program
-    glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-    glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-    std::vector<char> ProgramErrorMessage( max(InfoLogLength, int(1)) );
-    glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-    fprintf(stdout, "%s\n", &ProgramErrorMessage[0]);
-
-    glDeleteShader(VertexShaderID);
-    glDeleteShader(FragmentShaderID);
-
-    return ProgramID;
-}
-
 static void error_callback(int error, const char* description)
 {
     fprintf(stderr, "Error: %s\n", description);
@@ -118,101 +38,13 @@ static void error_callback(int error, const char* description)
 
 void quit(GLFWwindow *window)
 {
+    clearMeshCache();
     glfwDestroyWindow(window);
     glfwTerminate();
     exit(EXIT_SUCCESS);
 }
 
 
-/* Generate VAO, VBOs and return VAO handle */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
-{
-    struct VAO* vao = new struct VAO;
-    vao->PrimitiveMode = primitive_mode;
-    vao->NumVertices = numVertices;
-    vao->FillMode = fill_mode;
-
-    // Create Vertex Array Object
-    // Should be done after CreateWindow and before any other GL calls
-    glGenVertexArrays(1, &(vao->VertexArrayID)); // VAO
-    glGenBuffers (1, &(vao->VertexBuffer)); // VBO - vertices
-    glGenBuffers (1, &(vao->ColorBuffer));  // VBO - colors
-
-    glBindVertexArray (vao->VertexArrayID); // Bind the VAO 
-    glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer); // Bind the VBO vertices 
-    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), vertex_buffer_data, GL_STATIC_DRAW); // Copy the vertices into VBO
-    glVertexAttribPointer(
-            0,                  // attribute 0. Vertices
-            3,                  // size (x,y,z)
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void*)0            // array buffer offset
-            );
-
-    glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer); // Bind the VBO colors 
-    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), color_buffer_data, GL_STATIC_DRAW);  // Copy the vertex colors
-    glVertexAttribPointer(
-            1,                  // attribute 1. Color
-            3,                  // size (r,g,b)
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void*)0            // array buffer offset
-            );
-
-    return vao;
-}
-
-/* Generate VAO, VBOs and return VAO handle - Common Color for all vertices */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat red, const GLfloat green, const GLfloat blue, GLenum fill_mode=GL_FILL)
-{
-    GLfloat* color_buffer_data = new GLfloat [3*numVertices];
-    for (int i=0; i<numVertices; i++) {
-        color_buffer_data [3*i] = red;
-        color_buffer_data [3*i + 1] = green;
-        color_buffer_data [3*i + 2] = blue;
-    }
-
-    return create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
-}
-
-/* Render the VBOs handled by VAO */
-void draw3DObject (struct VAO* vao)
-{
-    // Change the Fill Mode for this object
-    glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
-
-    // Bind the VAO to use
-    glBindVertexArray (vao->VertexArrayID);
-
-    // Enable Vertex Attribute 0 - 3d Vertices
-    glEnableVertexAttribArray(0);
-    // Bind the VBO to use
-    glBindBuffer(GL_ARRAY_BUFFER, vao->VertexBuffer);
-
-    // Enable Vertex Attribute 1 - Color
-    glEnableVertexAttribArray(1);
-    // Bind the VBO to use
-    glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
-
-    // Draw the geometry !
-    glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
-}
-
-float formatAngle(float A)
-{
-    if(A<0.0f)
-        return A+360.0f;
-    if(A>=360.0f)
-        return A-360.0f;
-    return A;
-}
-float D2R(float A)
-{
-    return (A*PI)/180.0f;
-}
-
 typedef pair< float, float > dub;
 typedef pair< dub ,float > tup;
 #define F first
@@ -220,83 +52,9 @@ typedef pair< dub ,float > tup;
 #define mp make_pair
 #define pb push_back
 
-vector< tup > centre[1000];
-glm::vec3 trans[1000];
-float rotat[1000];
-VAO* objects[1000];
-float velx[1000];
-float vely[1000];
-bool movable[1000];
-float Timer[1000];
-float Mass[1000];
-float COR=0.6f;
-float startX[1000];
-float startY[1000];
-float currentX[1000];
-float currentY[1000];
-float ADG=1.0f;
-float tick=0.3f;
-
-float sqr(float x)
-{
-    return x*x;
-}
-float dis(dub p,dub q)
-{
-    return sqr(p.F-q.F)+sqr(p.S-q.S);
-}
-int collided(tup p,tup q)
-{
-    float cdis=dis(p.F,q.F);
-    float rsum=sqr(p.S+q.S);
-    if(cdis<=rsum)
-        return 1;
-    else
-        return 0;
-}
-
-bool checkCollision(int i,int j)
-{
-    float R;
-    tup A,B,V;
-    for(int k=0;k<centre[i].size();k++)
-    {
-        for(int l=0;l<centre[j].size();l++)
-        {
-            V=centre[i][k];
-            R=V.F.F;
-            A.F.F=trans[i][0]+R*cos(D2R(formatAngle(rotat[i])));
-            A.F.S=trans[i][1]+R*sin(D2R(formatAngle(rotat[i])));
-            A.S=V.S;
-
-            V=centre[j][l];
-            R=V.F.F;
-            B.F.F=trans[j][0]+R*cos(D2R(formatAngle(rotat[j])));
-            B.F.S=trans[j][1]+R*sin(D2R(formatAngle(rotat[j])));
-            B.S=V.S;
-            if(collided(A,B))
-            {
-                //cout << currentX[0] << " " << currentY[0] << "\n";
-                //cout << A.F.F << " " << A.F.S << " " << A.S << "\n";
-                //cout << B.F.F << " " << B.F.S << " " << B.S << "\n";
-                return true;
-            }
-        }
-    }
-    return false;
-}
-
-void divideRect(int i,float width,float height)
-{
-    for(int j=0;j<(int)(width/(2.0*height));j++)
-    {
-        centre[i].pb(mp(mp(-(2.0f*j+1.0f)*height,0.0f),height));
-    }
-    for(int j=0;j<(int)(width/(2.0*height));j++)
-    {
-        centre[i].pb(mp(mp((2.0f*j+1.0f)*height,0.0f),height));
-    }
-}
+vector<VAO*> objects; // mesh of each body slot
+/* Physics steps at a fixed rate of its own, -hz and -speed on the command line */
+FixedStep simClock={60.0f,1.0f,8,-1.0,0.0,0.0f};
 
 /*--------------------------------------------------------- CHANGEABLE FUNCTIONS ---------------------------------------------------------*/
 
@@ -334,6 +92,12 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
     }
 }
 
+bool hud = false; // frame times and the ball's state in the top left corner, 'h' or -hud
+
+/* Where the shot would go, drawn while aiming. The ball flies a plain parabola here (see
+   updatePositions), so the preview samples one rather than the drag model. */
+TrajectoryPreview aimPreview = trajectoryPreview(256, 120.0f, 0.0f, 255, 255, 0);
+
 /* Executed for character input (like in text boxes) */
 void keyboardChar (GLFWwindow* window, unsigned int key)
 {
@@ -342,6 +106,10 @@ void keyboardChar (GLFWwindow* window, unsigned int key)
         case 'q':
             quit(window);
             break;
+        case 'H':
+        case 'h':
+            hud = !hud;
+            break;
         default:
             break;
     }
@@ -351,7 +119,7 @@ float ux=30,uy=60;
 double xmousePos=0,ymousePos=0;
 float cur_angle=0;
 
-int mouseState=0,buttonPressed=0;
+int mouseState=0;
 float wheel1X=-330,wheel1Y=-240;
 float cannonX=0,cannonY=0;
 float constStartX=cannonX,constStartY=cannonY;
@@ -390,7 +158,8 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
     int fbwidth=width, fbheight=height;
     /* With Retina display on Mac OS X, GLFW's FramebufferSize
        is different from WindowSize */
-    glfwGetFramebufferSize(window, &fbwidth, &fbheight);
+    if (window) // No window when rendering offscreen
+        glfwGetFramebufferSize(window, &fbwidth, &fbheight);
 
     GLfloat fov = 90.0f;
 
@@ -406,48 +175,75 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
     // Matrices.projection = glm::perspective (fov, (GLfloat) fbwidth / (GLfloat) fbheight, 0.1f, 500.0f);
 
     // Ortho projection for 2D views
-    Matrices.projection = glm::ortho(-width/2.0f, width/2.0f, -height/2.0f, height/2.0f, 0.1f, 500.0f);
+    setOrtho(-width/2.0f, width/2.0f, -height/2.0f, height/2.0f, 0.1f, 500.0f);
 }
 
 //Define shapes
 VAO *triangle, *rectangle,*wheel1,*wheel2,*barrel,*firebarrel;
 VAO *leftWall,*rightWall,*bottomWall,*topWall,*tankhead;
 
-// Creates the triangle object used in this sample code
-VAO* createSector(float R,int parts)
+// Builds one sector of a circle cut into parts, centred on the x axis
+VAO* buildSector(float R,int parts)
 {
     float diff=360.0f/parts;
     float A1=formatAngle(-diff/2);
     float A2=formatAngle(diff/2);
     GLfloat vertex_buffer_data[]={0.0f,0.0f,0.0f,R*cos(D2R(A1)),R*sin(D2R(A1)),0.0f,R*cos(D2R(A2)),R*sin(D2R(A2)),0.0f};
     GLfloat color_buffer_data[]={1,0,0,1,0,0,1,0,0};
-    return create3DObject(GL_TRIANGLES,3,vertex_buffer_data,color_buffer_data,GL_FILL);
+    std::vector<Vertex> vertices=packVertices(3,vertex_buffer_data,color_buffer_data);
+    return createPooledObject(GL_TRIANGLES,3,&vertices[0],0,NULL,GL_FILL);
+}
+
+// Creates the triangle object used in this sample code
+VAO* createSector(float R,int parts)
+{
+    float params[]={R,(float)parts};
+    std::string key=meshKey("sector",params,2);
+    VAO* mesh=findMesh(key);
+    return mesh ? mesh : cacheMesh(key,buildSector(R,parts));
+}
+
+// Rotated sector copies from A1 to A2 every step degrees, cached together with the angles
+VAO* createArc(float R,int parts,float A1,float A2,float step)
+{
+    float params[]={R,(float)parts,A1,A2,step};
+    std::string key=meshKey("arc",params,5);
+    VAO* mesh=findMesh(key);
+    if(mesh)
+        return mesh;
+    mesh=buildSector(R,parts);
+    setSectorInstances(mesh,A1,A2,step);
+    return cacheMesh(key,mesh);
 }
 
 // Creates the rectangle object used in this sample code
 VAO* createRectangle(float x,float y)
 {
+    float params[]={x,y};
+    std::string key=meshKey("rectangle",params,2);
+    if(VAO* mesh=findMesh(key))
+        return mesh;
+
     GLfloat vertex_buffer_data [] = {
         -x,-y,0.0, // vertex 1
         x,-y,0.0, // vertex 2
         x, y,0.0, // vertex 3
-
-        x, y,0.0, // vertex 3
-        -x, y,0.0, // vertex 4
-        -x,-y,0.0  // vertex 1
+        -x, y,0.0  // vertex 4
     };
 
     GLfloat color_buffer_data [] = {
         1,0,0, // color 1
         1,0,0, // color 2
         1,0,0, // color 3
-
-        1,0,0, // color 3
-        1,0,0, // color 4
-        1,0,0  // color 1
+        1,0,0  // color 4
     };
-    // create3DObject creates and returns a handle to a VAO that can be used later
-    return create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+
+    // Two triangles sharing vertices 1 and 3
+    GLushort index_data [] = {0,1,2, 2,3,0};
+
+    // createPooledObject places the mesh in the shared geometry pool and returns its handle
+    std::vector<Vertex> vertices = packVertices(4, vertex_buffer_data, color_buffer_data);
+    return cacheMesh(key, createPooledObject(GL_TRIANGLES, 4, &vertices[0], 6, index_data, GL_FILL));
 }
 
 float camera_rotation_angle = 90;
@@ -455,171 +251,34 @@ float rectangle_rotation = 0;
 float triangle_rotation = 0;
 int count=0,fall=0;
 
+/* Queue obj for this frame - the GL work happens in flushRenderQueue() at the end of draw() */
 void drawobject(VAO* obj,glm::vec3 trans,float angle,glm::vec3 rotat)
 {
-    Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0));
-    glm::mat4 VP = Matrices.projection * Matrices.view;
-    glm::mat4 MVP;	// MVP = Projection * View * Model
+    if(rotat==glm::vec3(0,0,1))
+    {
+        queueObject(obj,trans[0],trans[1],trans[2],D2R(formatAngle(angle)));
+        return;
+    }
     Matrices.model = glm::mat4(1.0f);
     glm::mat4 translatemat = glm::translate(trans);
     glm::mat4 rotatemat = glm::rotate(D2R(formatAngle(angle)), rotat);
     Matrices.model *= (translatemat * rotatemat);
-    MVP = VP * Matrices.model;
-    glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-    draw3DObject(obj);
+    queueObject(obj,Matrices.model);
 }
 
 
-float EKMT(float K,float M,float T)
-{
-    return exp(-((K/M)*T));
-}
-float xvel(float V0,float K,float M,float T)
-{
-    return V0*EKMT(K,M,T);
-}
-float xdis(float V0,float K,float M,float T)
-{
-    return ((M/K)*V0)*(1.0f-EKMT(K,M,T));
-}
-float yvel(float V0,float K,float M,float T,float G)
-{
-    return ((V0+((M*G)/K))*EKMT(K,M,T))-((M*G)/K);
-}
-float ydis(float V0,float K,float M,float T,float G)
-{
-    return ((M/K)*(V0+((M*G)/K))*(1-EKMT(K,M,T)))-((M*G*T)/K);
-}
-float equilib(int i)
-{
-    return (Mass[i]/0.3f)*((vely[i]*0.3f+1.0f)/(Mass[i]*ADG));
-}
-/* Render the scene with openGL */
-void conserveMomentum(int i,int j)
-{
-    float u1,u2,v1,v2;
-    u1=xvel(velx[i],0.3f,Mass[i],Timer[i]);
-    u2=xvel(velx[j],0.3f,Mass[j],Timer[j]);
-    v1=(((Mass[i]-COR*Mass[j])*u1)/(Mass[i]+Mass[j]))+(((Mass[j]+COR*Mass[j])*u2)/(Mass[i]+Mass[j]));
-    v2=u1*COR-u2*COR+v1;
-    velx[i]=v1;
-    velx[j]=v2;
-    u1=yvel(vely[i],0.3f,Mass[i],Timer[i],ADG);
-    u2=yvel(vely[j],0.3f,Mass[j],Timer[j],ADG);
-    v1=(((Mass[i]-COR*Mass[j])*u1)/(Mass[i]+Mass[j]))+(((Mass[j]+COR*Mass[j])*u2)/(Mass[i]+Mass[j]));
-    v2=u1*COR-u2*COR+v1;
-    vely[i]=v1;
-    vely[j]=v2;
-}
-bool flag=true;
-void applyCollisions()
-{
-    for(int i=0;i<3;i++)
-    {
-        for(int j=i+1;j<3;j++)
-        {
-            if( ((velx[i]!=0 || vely[i]!=0) || (velx[j]!=0 || vely[j]!=0) ) && (movable[i] || movable[j]) && checkCollision(i,j) )
-            {
-                if(!movable[i])
-                {
-                    if(i==1)
-                    {
-                        vely[j]=-COR*yvel(vely[j],0.3f,Mass[j],Timer[j],ADG);
-                        startX[j]=trans[j][0];
-                        startY[j]=trans[j][1];
-                        Timer[j]=tick;
-                    }
-                }
-                //else if(!movable[j])
-                else if(!movable[j])
-                {
-                    if(j==1)
-                    {
-                        vely[i]=-COR*(vely[i]-ADG*Timer[i]);
-                        startX[i]=trans[i][0];
-                        startY[i]=trans[i][1];
-                        cout << startX[i] << " " << startY[i] << "\n";
-                        Timer[i]=0.0f;
-                        while(abs(yvel(vely[i],0.3f,Mass[i],Timer[i],ADG))>0.01f && checkCollision(i,j))
-                        {
-                            Timer[i]+=0.05f;
-                            trans[i][0]=currentX[i]=startX[i]+xdis(velx[i],0.3f,Mass[i],Timer[i]);
-                            trans[i][1]=currentY[i]=startY[i]+ydis(vely[i],0.3f,Mass[i],Timer[i],ADG);
-                        }
-                    }
-                    if(j==2)
-                    {
-                        velx[i]=-COR*xvel(velx[i],0.3f,Mass[i],Timer[i]);
-                        startX[i]=currentX[i];
-                        startY[i]=currentY[i];
-                        Timer[i]=0.0f;
-                        while(checkCollision(i,j))
-                        {
-                            Timer[i]+=0.05f;
-                            trans[i][0]=currentX[i]=startX[i]+xdis(velx[i],0.3f,Mass[i],Timer[i]);
-                            trans[i][1]=currentY[i]=startY[i]+ydis(vely[i],0.3f,Mass[i],Timer[i],ADG);
-                        }
-                        cout << trans[i][0] << " a " <<trans[i][1] << "\n";
-                        cout << currentX[i] << " b " << currentY[i] << "\n";
-                    }
-                }
-                else if(movable[i] && movable[j])
-                {
-                    conserveMomentum(i,j);
-                    // Iterate over all objects to move time frame - TODO
-                    startX[i]=currentX[i];
-                    startY[i]=currentY[i];
-                    startX[j]=currentX[j];
-                    startY[j]=currentY[j];
-                    Timer[i]=tick;
-                    Timer[j]=tick;
-                    while(checkCollision(i,j))
-                    {
-                        Timer[i]+=0.05f;
-                        Timer[j]+=0.05f;
-                        trans[i][0]=currentX[i]=startX[i]+xdis(velx[i],0.3f,Mass[i],Timer[i]);
-                        trans[i][1]=currentY[i]=startY[i]+ydis(vely[i],0.3f,Mass[i],Timer[i],ADG);
-
-                        trans[j][0]=currentX[j]=startX[j]+xdis(velx[j],0.3f,Mass[j],Timer[j]);
-                        trans[j][1]=currentY[j]=startY[j]+ydis(vely[j],0.3f,Mass[j],Timer[j],ADG);
-                    }
-                    flag=false;
-                }
-            }
-        }
-    }
-}
-
-float rotateBarrel=0,prevBAngle;
+float prevBAngle;
 float prevCannonX,prevCannonY;
 float xpos,prevPX,prevPY;
 
-void updatePositions()
-{
-    if(1-buttonPressed)
-    {
-        currentX[0]=-280.f+40*cos(D2R(rotateBarrel));
-        currentY[0]=-210.0f+40*sin(D2R(rotateBarrel));
-        startX[0]=currentX[0];
-        startY[0]=currentY[0];
-    }
-    for(int i=1-buttonPressed;i<3;i++)
-    {
-        float veloy=yvel(vely[i],0.3f,Mass[i],Timer[i],ADG);
-        float velox=xvel(velx[i],0.3f,Mass[i],Timer[i]);
-        if(i==0)
-        {
-        }
-        if(velx[i]!=0.0f || vely[i]!=0.0f)
-        {
-            currentX[i]=startX[i]+(velx[i]*Timer[i]);
-            currentY[i]=startY[i]+(vely[i]*Timer[i]-0.5*ADG*sqr(Timer[i]));
-            trans[i][0]=currentX[i];
-            trans[i][1]=currentY[i];
-            Timer[i]+=tick;
-        }
-    }
+int fixedFrame=-1; // frame number when frames are 1/60 s apart (offscreen and benchmark runs), -1 on the wall clock
 
+/* Seconds the simulation clock reads : fixed frames are 1/60 s apart, whatever they take */
+double frameTime()
+{
+    if (fixedFrame >= 0)
+        return fixedFrame/60.0;
+    return glfwGetTime();
 }
 
 /* Render the scene with openGL */
@@ -627,43 +286,54 @@ void updatePositions()
 
 void draw ()
 {
+    TRACE_SCOPE("draw");
     if(buttonPressed==0)
     {
         rotateBarrel=atan2((530-ymousePos),(xmousePos-40))*(180/M_PI);
         cur_angle=atan2((530-ymousePos),(xmousePos-40))*(180/M_PI);
-        startX[0]=constStartX=cannonX=-280+60*cos(rotateBarrel*(M_PI/180));
-        startY[0]=constStartY=cannonY=-210+60*sin(rotateBarrel*(M_PI/180));
-        trans[0][0]=cannonX;
-        trans[0][1]=cannonY;
+        constStartX=cannonX=-280+60*cos(rotateBarrel*(M_PI/180));
+        constStartY=cannonY=-210+60*sin(rotateBarrel*(M_PI/180));
         xpos=xmousePos;
         float speed=xpos-constStartX;
         float u=20*(speed/400);
-        ux=u*cos(cur_angle*(M_PI/180));
-        uy=u*sin(cur_angle*(M_PI/180));
-        velx[0]=ux;
-        vely[0]=uy;
+        aimBall(cur_angle,u);
+        ux=velx[ball];
+        uy=vely[ball];
     }
 
-    if(buttonPressed==1)
+    // Run the physics steps that are due, however long the last frame took
+    double physicsStart=benchNow();
+    int steps=stepsDue(simClock,frameTime());
+    for(int s=0;s<steps;s++)
+    {
+        beginStep(bodies);
+        stepSimulation();
+        endStep(bodies);
+    }
+    // The path from the barrel's mouth, where the ball leaves the barrel, rebuilt only when the aim moves.
+    // Until the shot the steps build no grid, so it is built here for the path to stop at the ground and the wall
+    if(buttonPressed==0)
     {
-        applyCollisions();
+        buildBroadphase(collisionGrid,bodies,2.0f);
+        updateTrajectoryPreview(aimPreview,bodies,ball,collisionGrid,-280.f+40*cos(D2R(cur_angle)),-210.0f+40*sin(D2R(cur_angle)),velx[ball],vely[ball],ADG,NULL);
     }
-    updatePositions();
+    double submitStart=benchNow();
+    frameTimes.physics=submitStart-physicsStart;
+    // Ball drawn between its last two steps
+    glm::vec3 ballPos=renderPosition(bodies,ball,simClock.alpha);
     // clear the color and depth in the frame buffer
     glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // use the loaded shader program
+    // use the loaded shader program, rebuilt first if its files changed (-hot-reload)
     // Don't change unless you know what you are doing
+    pollShaderReload();
     glUseProgram (programID);
 
     //1st glm::vec3(xpos,ypos), 2nd glm::vec3(rotate about) 
     //projectile
 
     //Semi circle
-    for(int k=0;k<180;k++)
-    {
-        drawobject(tankhead,glm::vec3(-280,-210,0),k,glm::vec3(0,0,1));
-    }
+    drawobject(tankhead,glm::vec3(-280,-210,0),0,glm::vec3(0,0,1));
     //Left Wall
     drawobject(leftWall,glm::vec3(-390,50,0),0,glm::vec3(0,0,1));
     //bottom Wall
@@ -673,39 +343,44 @@ void draw ()
     //Right wall
     drawobject(rightWall,glm::vec3(390,50,0),90,glm::vec3(0,0,1));
     //Left Wheel
-    for(int i=0;i<360;i++)
-    {
-        drawobject(wheel1,glm::vec3(wheel1X,wheel1Y,0),i,glm::vec3(0,0,1));
-    }
+    drawobject(wheel1,glm::vec3(wheel1X,wheel1Y,0),0,glm::vec3(0,0,1));
     //Right Wheel
-    for(int j=0;j<360;j++)
-    {
-        drawobject(wheel2,glm::vec3(-235,-240,0),j,glm::vec3(0,0,1));
-    }
+    drawobject(wheel2,glm::vec3(-235,-240,0),0,glm::vec3(0,0,1));
     //Joining wheels
     drawobject(barrel,glm::vec3(-285,-240,0),0,glm::vec3(0,0,1));
     //Cannon Barrel
     if(rotateBarrel>=25.0052 && rotateBarrel<=100)
     {
-        for(int i=0;i<360;i++)
-        {
-            drawobject(rectangle,glm::vec3(trans[0][0],trans[0][1],0),i,glm::vec3(0,0,1));
-        }
+        drawobject(rectangle,glm::vec3(ballPos[0],ballPos[1],0),0,glm::vec3(0,0,1));
         rotateBarrel=atan2((530-ymousePos),(xmousePos-40))*(180/M_PI);
         drawobject(firebarrel,glm::vec3(-280+40*cos(rotateBarrel*(M_PI/180)),-210+40*sin(rotateBarrel*(M_PI/180)),0),rotateBarrel,glm::vec3(0,0,1));
         prevBAngle=rotateBarrel;
-        prevCannonX=trans[0][0];
-        prevCannonY=trans[0][1];
+        prevCannonX=ballPos[0];
+        prevCannonY=ballPos[1];
     }
     else
     {
-        for(int i=0;i<360;i++)
-        {
-            drawobject(rectangle,glm::vec3(prevCannonX,prevCannonY,0),i,glm::vec3(0,0,1));
-        }
+        drawobject(rectangle,glm::vec3(prevCannonX,prevCannonY,0),0,glm::vec3(0,0,1));
         rotateBarrel=atan2((530-ymousePos),(xmousePos-40))*(180/M_PI);
         drawobject(firebarrel,glm::vec3(-280+40*cos(prevBAngle*(M_PI/180)),-210+40*sin(prevBAngle*(M_PI/180)),0),prevBAngle,glm::vec3(0,0,1));
     }
+
+    if(buttonPressed==0)
+        drawobject(aimPreview.vao,glm::vec3(0,0,0),0,glm::vec3(0,0,1));
+
+    // Draw everything queued above
+    flushRenderQueue();
+    if (hud) {
+        char text[256];
+        snprintf(text, sizeof(text), "physics %6.2f ms\nsubmit  %6.2f ms\ndraws   %3d\n\nball %6.1f %6.1f\nspeed %5.1f %5.1f",
+                 frameTimes.physics*1000, frameTimes.submit*1000, renderDrawCalls,
+                 ballPos[0], ballPos[1], velx[ball], vely[ball]);
+        queueText(20, 20, text, 1, 255, 255, 255);
+    }
+    flushText();
+    frameTimes.submit=benchNow()-submitStart;
+    TRACE_COUNTER("checkCollision", collisionChecks);
+    collisionChecks=0;
     //cout << "cannon coordinates " << cannonX << " " << cannonY << endl;
 }
 
@@ -759,47 +434,43 @@ GLFWwindow* initGLFW (int width, int height)
 
 /* Initialize the OpenGL rendering properties */
 /* Add all the models to be created here */
+/* Get a handle for our "Model" uniform and share the camera block, again for each reloaded program */
+void setupProgram (GLuint program)
+{
+    Matrices.MatrixID = glGetUniformLocation(program, "Model");
+    bindCameraBlock(program);
+}
+
 void initGL (GLFWwindow* window, int width, int height)
 {
+    TRACE_SCOPE("initGL");
     /* Objects should be created before any other gl function and shaders */
+    // Create the bodies : the ball, the ground and the right wall
+    createScene();
+    objects.resize(bodyCount(bodies));
     // Create the models
     // For the cannon base
-    wheel1=createSector(30,18); // Generate the VAO, VBOs, vertices data & copy into the array buffer
-    wheel2=createSector(30,18); // Generate the VAO, VBOs, vertices data & copy into the array buffer
+    wheel1=createArc(30,18,0,359,1); // 360 rotated copies of one sector, drawn in one call
+    wheel2=createArc(30,18,0,359,1); // Same mesh as wheel1, from the cache
     barrel=createRectangle(50,30);
     firebarrel=createRectangle(60,10);
-    tankhead=createSector(30,25);
+    tankhead=createArc(30,25,0,179,1); // Semi circle
     //set sizes length,breadth
-    rectangle=createSector(10,18);
-    objects[0]=rectangle;
-    centre[0].pb(mp(mp(0.0f,0.0f),12.0f));
-    trans[0]=glm::vec3(0.0f,0.0f,0.0f);
-    currentX[0]=0.0f;
-    currentY[0]=0.0f;
-    rotat[0]=0.0f;
-    movable[0]=true;
-    Mass[0]=200.0f;
-    Timer[0]=0.0f;
-    velx[0]=0.0f;
-    vely[0]=0.0f;
+    rectangle=createArc(10,18,0,359,1);
+    objects[ball]=rectangle;
     leftWall=createRectangle(10,500);
     bottomWall=createRectangle(400,10);
-    objects[1]=bottomWall;
-    divideRect(1,500.0f,10.0f);
-    trans[1]=glm::vec3(0.0f,-290.0f,0.0f);
-    rotat[1]=0.0f;
-    movable[1]=false;
+    objects[ground]=bottomWall;
     topWall=createRectangle(500,10);
     rightWall=createRectangle(350.0f,10.0f);
-    objects[2]=rightWall;
-    divideRect(2,350.0f,10.0f);
-    trans[2]=glm::vec3(640.0f,0.0f,0.0f);
-    rotat[2]=90.0f;
-    movable[2]=false;
-    // Create and compile our GLSL program from the shaders
-    programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
-    // Get a handle for our "MVP" uniform
-    Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+    objects[wall]=rightWall;
+    // Create and compile our GLSL programs from the shaders, all at once
+    addShaderProgram(&programID, "Sample_GL.vert", "Sample_GL.frag", setupProgram);
+    initText();
+    if (!buildShaderPrograms())
+        exit(EXIT_FAILURE);
+    if (shaderReload.enabled)
+        startShaderReload();
 
     reshapeWindow (window, width, height);
 
@@ -816,11 +487,136 @@ void initGL (GLFWwindow* window, int width, int height)
     cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 }
 
+/* Feed this frame's scripted events to the input handlers, in place of the window's */
+void replayInput (InputScript& script, int frame, GLFWwindow* window)
+{
+    while (const ScriptEvent* event = nextEvent(script, frame)) {
+        switch (event->type) {
+            case SCRIPT_CURSOR:
+                xmousePos = event->x;
+                ymousePos = event->y;
+                break;
+            case SCRIPT_PRESS:
+            case SCRIPT_RELEASE:
+                mouseButton(window, event->key ? GLFW_MOUSE_BUTTON_RIGHT : GLFW_MOUSE_BUTTON_LEFT,
+                            event->type == SCRIPT_PRESS ? GLFW_PRESS : GLFW_RELEASE, 0);
+                break;
+            case SCRIPT_KEY:
+                // GLFW key codes of letters and digits are their upper case characters
+                keyboard(window, toupper(event->key), 0, GLFW_PRESS, 0);
+                keyboardChar(window, event->key);
+                keyboard(window, toupper(event->key), 0, GLFW_RELEASE, 0);
+                break;
+        }
+    }
+}
+
 int main (int argc, char** argv)
 {
     int width = 801;
     int height = 601;
 
+    int frames = 0;            // -offscreen N : render N frames with no window
+    const char* out = "frame"; // -out prefix : written as prefix_0000.ppm, ...
+    const char* format = "ppm"; // -png : write PNG instead
+    const char* scriptPath = NULL; // -script file : replay its input instead of the mouse and keyboard
+    const char* benchPath = NULL;  // -bench file.json : time the scripted frames, vsync off, and write the statistics
+    const char* tracePath = NULL;  // -trace file.json : record a Chrome trace, written at exit
+    for (int i=1; i+1<argc; i++) {
+        if (!strcmp(argv[i], "-hz"))
+            simClock.rate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-speed"))
+            simClock.timeScale = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-offscreen"))
+            frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-out"))
+            out = argv[++i];
+        else if (!strcmp(argv[i], "-script"))
+            scriptPath = argv[++i];
+        else if (!strcmp(argv[i], "-bench"))
+            benchPath = argv[++i];
+        else if (!strcmp(argv[i], "-trace"))
+            tracePath = argv[++i];
+        else if (!strcmp(argv[i], "-shaders"))
+            shaderDirectory = argv[++i]; // -shaders dir : read the shaders from dir, not the built in copies
+    }
+    for (int i=1; i<argc; i++) {
+        if (!strcmp(argv[i], "-png"))
+            format = "png";
+        else if (!strcmp(argv[i], "-hot-reload"))
+            shaderReload.enabled = true; // rebuild the shaders when their files change, from -shaders or here
+        else if (!strcmp(argv[i], "-hud"))
+            hud = true;
+    }
+    if (shaderReload.enabled && !shaderDirectory)
+        shaderDirectory = ".";
+    if (simClock.rate <= 0)
+        simClock.rate = 60.0f;
+
+    if (tracePath)
+        startTrace(tracePath);
+
+    InputScript script;
+    if (scriptPath && !loadScript(scriptPath, script))
+        exit(EXIT_FAILURE);
+
+    /* Offscreen and benchmark runs go frame by frame on the fixed clock, fed only by the script.
+       A benchmark runs the script's frames in a window, or N frames offscreen with -offscreen N,
+       and writes no images. */
+    if (frames > 0 || benchPath) {
+        GLFWwindow* window = NULL;
+        if (frames > 0) {
+            if (!createOffscreenContext())
+                exit(EXIT_FAILURE);
+            gladLoadGLLoader((GLADloadproc) getProcAddress);
+            if (!createOffscreenFramebuffer(width, height))
+                exit(EXIT_FAILURE);
+        }
+        else {
+            window = initGLFW(width, height);
+            glfwSwapInterval(0);
+            frames = scriptPath ? script.frames : 600;
+        }
+        initGL (window, width, height);
+
+        FrameStats stats;
+        for (fixedFrame=0; fixedFrame<frames; fixedFrame++) {
+            double start = benchNow();
+            replayInput(script, fixedFrame, window);
+            draw();
+            if (window) {
+                {
+                    TRACE_SCOPE("glfwSwapBuffers");
+                    glfwSwapBuffers(window);
+                }
+                glfwPollEvents();
+            }
+            if (benchPath) {
+                glFinish(); // Count the GPU's work in the frame it belongs to
+                recordFrame(stats, benchNow()-start, renderDrawCalls);
+                continue;
+            }
+            char path[1024];
+            snprintf(path, sizeof(path), "%s_%04d.%s", out, fixedFrame, format);
+            if (!writeFrame(path))
+                exit(EXIT_FAILURE);
+        }
+
+        if (benchPath) {
+            FILE* file = fopen(benchPath, "w");
+            if (!file) {
+                fprintf(stderr, "Cannot write %s\n", benchPath);
+                exit(EXIT_FAILURE);
+            }
+            writeBenchJSON(file, stats, window ? "window" : "offscreen", (const char*) glGetString(GL_RENDERER));
+            fclose(file);
+        }
+        clearMeshCache();
+        if (window)
+            glfwTerminate();
+        exit(EXIT_SUCCESS);
+    }
+
     GLFWwindow* window = initGLFW(width, height);
 
     initGL (window, width, height);
@@ -834,7 +630,10 @@ int main (int argc, char** argv)
         draw();
 
         // Swap Frame Buffer in float buffering
-        glfwSwapBuffers(window);
+        {
+            TRACE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
 
         // Poll for Keyboard and mouse events
         glfwPollEvents();
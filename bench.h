@@ -0,0 +1,195 @@
+/* Scripted input and frame-time statistics for benchmark runs */
+/* Needs no GL or window system : the program maps script events onto its own input handlers */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/*--------------------------------------------------------- INPUT SCRIPT ---------------------------------------------------------*/
+
+/* A script is a text file of input events, one per line, each tagged with the frame it happens
+   at. Blank lines and lines starting with # are skipped.
+
+       frames 600            frames to run (600 by default)
+       0 cursor 300 300      cursor moves to window position (300,300)
+       120 press left        mouse button goes down (left or right)
+       121 release left      mouse button comes up
+       130 click right       press and release in the same frame
+       200 key c             key pressed and released
+
+   Events must be in frame order; several can share a frame and happen in file order. */
+
+enum { SCRIPT_CURSOR, SCRIPT_PRESS, SCRIPT_RELEASE, SCRIPT_KEY };
+
+struct ScriptEvent {
+    int frame;
+    int type;
+    double x, y;  // cursor position
+    int key;      // 0 left / 1 right button, or the key's character
+};
+
+struct InputScript {
+    int frames;
+    std::vector<ScriptEvent> events;
+    size_t next;  // first event not yet replayed
+    InputScript() : frames(0), next(0) {}
+};
+
+bool loadScript(const char* path, InputScript& script)
+{
+    script.frames = 600;
+    script.events.clear();
+    script.next = 0;
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Script: cannot open %s\n", path);
+        return false;
+    }
+    char line[256], word[32], arg[32];
+    int lineNumber = 0, lastFrame = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char* text = line;
+        while (*text == ' ' || *text == '\t')
+            text++;
+        if (*text == '#' || *text == '\n' || *text == '\r' || *text == 0)
+            continue;
+        if (sscanf(text, "frames %d", &script.frames) == 1)
+            continue;
+
+        ScriptEvent event;
+        event.x = event.y = 0;
+        event.key = 0;
+        int n = sscanf(text, "%d %31s %31s", &event.frame, word, arg);
+        if (n >= 2 && !strcmp(word, "cursor") && sscanf(text, "%*d %*s %lf %lf", &event.x, &event.y) == 2)
+            event.type = SCRIPT_CURSOR;
+        else if (n == 3 && !strcmp(word, "key") && strlen(arg) == 1) {
+            event.type = SCRIPT_KEY;
+            event.key = arg[0];
+        }
+        else if (n == 3 && (!strcmp(arg, "left") || !strcmp(arg, "right"))
+                 && (!strcmp(word, "press") || !strcmp(word, "release") || !strcmp(word, "click"))) {
+            event.key = strcmp(arg, "left") ? 1 : 0;
+            event.type = strcmp(word, "release") ? SCRIPT_PRESS : SCRIPT_RELEASE;
+            if (!strcmp(word, "click")) {
+                script.events.push_back(event);
+                event.type = SCRIPT_RELEASE;
+            }
+        }
+        else
+            ok = false;
+        if (ok && event.frame < lastFrame)
+            ok = false;
+        if (!ok) {
+            fprintf(stderr, "Script: %s:%d: cannot read \"%s\"\n", path, lineNumber, strtok(text, "\r\n"));
+            break;
+        }
+        lastFrame = event.frame;
+        script.events.push_back(event);
+    }
+    fclose(file);
+    return ok;
+}
+
+/* Next event due by this frame, or NULL once they have all been replayed */
+const ScriptEvent* nextEvent(InputScript& script, int frame)
+{
+    if (script.next >= script.events.size() || script.events[script.next].frame > frame)
+        return NULL;
+    return &script.events[script.next++];
+}
+
+/*--------------------------------------------------------- FRAME STATISTICS ---------------------------------------------------------*/
+
+/* Seconds on a monotonic clock */
+double benchNow()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* CPU time draw() spent stepping the physics and queueing + submitting the scene, last frame */
+struct FrameTimes {
+    double physics;
+    double submit;
+} frameTimes = {0, 0};
+
+struct FrameStats {
+    std::vector<double> frame, physics, submit;  // seconds
+    std::vector<int> drawCalls;
+};
+
+void recordFrame(FrameStats& stats, double frameSeconds, int drawCalls)
+{
+    stats.frame.push_back(frameSeconds);
+    stats.physics.push_back(frameTimes.physics);
+    stats.submit.push_back(frameTimes.submit);
+    stats.drawCalls.push_back(drawCalls);
+}
+
+int compareDoubles(const void* a, const void* b)
+{
+    double x = *(const double*) a, y = *(const double*) b;
+    return x < y ? -1 : x > y;
+}
+
+/* {"mean":..,"p50":..,"p95":..,"p99":..,"max":..} of the samples, scaled by unit */
+void writeSummaryJSON(FILE* file, const char* name, std::vector<double> samples, double unit)
+{
+    int n = samples.size();
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+        sum += samples[i];
+    if (n)
+        qsort(&samples[0], n, sizeof(double), compareDoubles);
+    fprintf(file, "  \"%s\": {", name);
+    if (n) {
+        static const int percentiles[] = {50, 95, 99};
+        fprintf(file, "\"mean\": %.4f", unit*sum/n);
+        for (int k = 0; k < 3; k++) {
+            int rank = (percentiles[k]*n + 99)/100;  // nearest rank
+            fprintf(file, ", \"p%d\": %.4f", percentiles[k], unit*samples[rank > 0 ? rank-1 : 0]);
+        }
+        fprintf(file, ", \"max\": %.4f", unit*samples[n-1]);
+    }
+    fprintf(file, "}");
+}
+
+/* JSON string contents with quotes, backslashes and control characters escaped */
+void writeEscapedJSON(FILE* file, const char* text)
+{
+    for (; text && *text; text++) {
+        if (*text == '"' || *text == '\\')
+            fprintf(file, "\\%c", *text);
+        else if ((unsigned char) *text < 0x20)
+            fprintf(file, "\\u%04x", *text);
+        else
+            fputc(*text, file);
+    }
+}
+
+/* One JSON object : the run's setup, then frame, physics and submit times in milliseconds and draw calls per frame */
+void writeBenchJSON(FILE* file, const FrameStats& stats, const char* backend, const char* renderer)
+{
+    std::vector<double> drawCalls(stats.drawCalls.begin(), stats.drawCalls.end());
+    fprintf(file, "{\n");
+    fprintf(file, "  \"frames\": %d,\n", (int) stats.frame.size());
+    fprintf(file, "  \"backend\": \"%s\",\n", backend);
+    fprintf(file, "  \"renderer\": \"");
+    writeEscapedJSON(file, renderer);
+    fprintf(file, "\",\n");
+    writeSummaryJSON(file, "frame_ms", stats.frame, 1000.0);
+    fprintf(file, ",\n");
+    writeSummaryJSON(file, "physics_ms", stats.physics, 1000.0);
+    fprintf(file, ",\n");
+    writeSummaryJSON(file, "submit_ms", stats.submit, 1000.0);
+    fprintf(file, ",\n");
+    writeSummaryJSON(file, "draw_calls", drawCalls, 1.0);
+    fprintf(file, "\n}\n");
+}
+
+#endif
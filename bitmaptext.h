@@ -0,0 +1,247 @@
+/* Bitmap-font text : glyphs from one atlas texture, every string of a frame drawn in one call */
+/* Include after render.h and shaderprograms.h. The program's shaders must include Text.vert and Text.frag */
+#ifndef BITMAPTEXT_H
+#define BITMAPTEXT_H
+
+#include <vector>
+
+#include "trace.h"
+
+/* The font below is built into a single-channel texture at startup, one glyph per cell. Strings
+   are queued with queueText() in pixels from the top left corner of the viewport, each glyph
+   becoming a quad in a list rebuilt every frame, and flushText() streams the whole list into one
+   buffer (orphaning last frame's) and draws it with one call of its own program, so a debug
+   overlay costs the same one draw for ten glyphs or ten thousand. Text goes over everything and
+   needs no compatibility-profile calls, unlike glutBitmapCharacter. */
+
+#define TEXT_GLYPH 8            // glyph cell in texels, and in pixels at scale 1
+#define TEXT_LINE 10            // distance between lines at scale 1
+#define TEXT_FIRST 32           // the font runs from ' '
+#define TEXT_GLYPHS 95          // to '~'
+#define TEXT_ATLAS_COLUMNS 16
+#define TEXT_ATLAS_WIDTH (TEXT_ATLAS_COLUMNS*TEXT_GLYPH)
+#define TEXT_ATLAS_HEIGHT (8*TEXT_GLYPH)   // 16 x 8 cells, room for 128 glyphs
+
+/* 8x8 public domain font, a row per byte from the top, bit 0 the leftmost pixel */
+const unsigned char textFont[TEXT_GLYPHS][TEXT_GLYPH] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // space
+    {0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00},  // !
+    {0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // "
+    {0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00},  // #
+    {0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00},  // $
+    {0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00},  // %
+    {0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00},  // &
+    {0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00},  // '
+    {0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00},  // (
+    {0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00},  // )
+    {0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00},  // *
+    {0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00},  // +
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06},  // ,
+    {0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00},  // -
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00},  // .
+    {0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00},  // /
+    {0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00},  // 0
+    {0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00},  // 1
+    {0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00},  // 2
+    {0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00},  // 3
+    {0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00},  // 4
+    {0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00},  // 5
+    {0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00},  // 6
+    {0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00},  // 7
+    {0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00},  // 8
+    {0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00},  // 9
+    {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00},  // :
+    {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06},  // ;
+    {0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00},  // <
+    {0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00},  // =
+    {0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00},  // >
+    {0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00},  // ?
+    {0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00},  // @
+    {0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00},  // A
+    {0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00},  // B
+    {0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00},  // C
+    {0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00},  // D
+    {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00},  // E
+    {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00},  // F
+    {0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00},  // G
+    {0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00},  // H
+    {0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},  // I
+    {0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00},  // J
+    {0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00},  // K
+    {0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00},  // L
+    {0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00},  // M
+    {0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00},  // N
+    {0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00},  // O
+    {0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00},  // P
+    {0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00},  // Q
+    {0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00},  // R
+    {0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00},  // S
+    {0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},  // T
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00},  // U
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00},  // V
+    {0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00},  // W
+    {0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00},  // X
+    {0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00},  // Y
+    {0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00},  // Z
+    {0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00},  // [
+    {0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00},  // backslash
+    {0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00},  // ]
+    {0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00},  // ^
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF},  // _
+    {0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00},  // `
+    {0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00},  // a
+    {0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00},  // b
+    {0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00},  // c
+    {0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00},  // d
+    {0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00},  // e
+    {0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00},  // f
+    {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F},  // g
+    {0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00},  // h
+    {0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},  // i
+    {0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E},  // j
+    {0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00},  // k
+    {0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},  // l
+    {0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00},  // m
+    {0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00},  // n
+    {0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00},  // o
+    {0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F},  // p
+    {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78},  // q
+    {0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00},  // r
+    {0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00},  // s
+    {0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00},  // t
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00},  // u
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00},  // v
+    {0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00},  // w
+    {0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00},  // x
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F},  // y
+    {0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00},  // z
+    {0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00},  // {
+    {0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00},  // |
+    {0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00},  // }
+    {0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // ~
+};
+
+/* Glyph corner : position in pixels, atlas coordinates normalised to 0..65535, RGB8 colour */
+struct TextVertex {
+    GLfloat x, y;
+    GLushort u, v;
+    GLubyte r, g, b, a;
+};
+
+struct TextRenderer {
+    GLuint program;                    // built with the others by buildShaderPrograms()
+    GLint ViewportID;                  // "Viewport" uniform, the viewport size in pixels
+    GLuint texture;
+    GLuint VertexArrayID, VertexBuffer;
+    std::vector<TextVertex> vertices;  // this frame's quads, two triangles a glyph
+    int glyphs;                        // glyphs drawn by the last flush
+} textRenderer;
+
+/* Uniforms of a linked text program, again for each reloaded one */
+void setupTextProgram(GLuint program)
+{
+    textRenderer.ViewportID = glGetUniformLocation(program, "Viewport");
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "Atlas"), 0);
+    glUseProgram(0);
+}
+
+/* Build the atlas and vertex array, and register the text program. Call before buildShaderPrograms(). */
+void initText()
+{
+    std::vector<GLubyte> atlas(TEXT_ATLAS_WIDTH*TEXT_ATLAS_HEIGHT, 0);
+    for (int glyph = 0; glyph < TEXT_GLYPHS; glyph++) {
+        int left = glyph%TEXT_ATLAS_COLUMNS*TEXT_GLYPH, top = glyph/TEXT_ATLAS_COLUMNS*TEXT_GLYPH;
+        for (int y = 0; y < TEXT_GLYPH; y++)
+            for (int x = 0; x < TEXT_GLYPH; x++)
+                if ((textFont[glyph][y] >> x) & 1)
+                    atlas[(top+y)*TEXT_ATLAS_WIDTH + left+x] = 255;
+    }
+    glGenTextures (1, &textRenderer.texture);
+    glBindTexture (GL_TEXTURE_2D, textRenderer.texture);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_R8, TEXT_ATLAS_WIDTH, TEXT_ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, &atlas[0]);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenVertexArrays (1, &textRenderer.VertexArrayID);
+    glBindVertexArray (textRenderer.VertexArrayID);
+    glGenBuffers (1, &textRenderer.VertexBuffer);
+    glBindBuffer (GL_ARRAY_BUFFER, textRenderer.VertexBuffer);
+    glEnableVertexAttribArray (0);
+    glVertexAttribPointer (0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*) 0);
+    glEnableVertexAttribArray (1);
+    glVertexAttribPointer (1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(TextVertex), (void*) (2*sizeof(GLfloat)));
+    glEnableVertexAttribArray (2);
+    glVertexAttribPointer (2, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), (void*) (2*sizeof(GLfloat)+2*sizeof(GLushort)));
+    glBindVertexArray (0);
+
+    addShaderProgram(&textRenderer.program, "Text.vert", "Text.frag", setupTextProgram);
+}
+
+/* Queue text with its top left corner at (x, y) pixels, glyphs scale times 8 pixels square.
+   A newline starts a line under the first, characters outside the font show as '?'. */
+void queueText(float x, float y, const char* text, float scale, GLubyte r, GLubyte g, GLubyte b)
+{
+    float size = TEXT_GLYPH*scale, left = x;
+    for (const char* c = text; *c; c++) {
+        if (*c == '\n') {
+            x = left;
+            y += TEXT_LINE*scale;
+            continue;
+        }
+        int glyph = (unsigned char) *c - TEXT_FIRST;
+        if (glyph < 0 || glyph >= TEXT_GLYPHS)
+            glyph = '?' - TEXT_FIRST;
+        if (glyph > 0) {  // nothing to draw for a space
+            int column = glyph%TEXT_ATLAS_COLUMNS, row = glyph/TEXT_ATLAS_COLUMNS;
+            GLushort u0 = column*TEXT_GLYPH*65535/TEXT_ATLAS_WIDTH, u1 = (column+1)*TEXT_GLYPH*65535/TEXT_ATLAS_WIDTH;
+            GLushort v0 = row*TEXT_GLYPH*65535/TEXT_ATLAS_HEIGHT, v1 = (row+1)*TEXT_GLYPH*65535/TEXT_ATLAS_HEIGHT;
+            TextVertex quad[6] = {
+                {x, y, u0, v0, r, g, b, 255}, {x, y+size, u0, v1, r, g, b, 255}, {x+size, y+size, u1, v1, r, g, b, 255},
+                {x, y, u0, v0, r, g, b, 255}, {x+size, y+size, u1, v1, r, g, b, 255}, {x+size, y, u1, v0, r, g, b, 255},
+            };
+            textRenderer.vertices.insert(textRenderer.vertices.end(), quad, quad+6);
+        }
+        x += size;
+    }
+}
+
+/* Draw everything queued this frame over the scene, then empty the queue. Leaves the current
+   program and depth test as they were. */
+void flushText()
+{
+    textRenderer.glyphs = textRenderer.vertices.size()/6;
+    if (textRenderer.vertices.empty() || !textRenderer.program) {
+        textRenderer.vertices.clear();
+        return;
+    }
+    TRACE_SCOPE("flushText");
+    GLint viewport[4], previous = 0;
+    glGetIntegerv (GL_VIEWPORT, viewport);
+    glGetIntegerv (GL_CURRENT_PROGRAM, &previous);
+    glUseProgram (textRenderer.program);
+    glUniform2f (textRenderer.ViewportID, viewport[2], viewport[3]);
+    glActiveTexture (GL_TEXTURE0);
+    glBindTexture (GL_TEXTURE_2D, textRenderer.texture);
+
+    glBindVertexArray (textRenderer.VertexArrayID);
+    glBindBuffer (GL_ARRAY_BUFFER, textRenderer.VertexBuffer);
+    int bytes = textRenderer.vertices.size()*sizeof(TextVertex);
+    glBufferData (GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW); // Orphan last frame's glyphs
+    glBufferSubData (GL_ARRAY_BUFFER, 0, bytes, &textRenderer.vertices[0]);
+
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable (GL_DEPTH_TEST);
+    glPolygonMode (GL_FRONT_AND_BACK, GL_FILL);
+    glDrawArrays (GL_TRIANGLES, 0, textRenderer.vertices.size());
+    renderDrawCalls++;  // counted with the render queue's
+    if (depthTest)
+        glEnable (GL_DEPTH_TEST);
+    glUseProgram (previous);
+    textRenderer.vertices.clear();
+}
+
+#endif
@@ -0,0 +1,101 @@
+/* Generated by make from Sample_GL.vert Sample_GL.frag Text.vert Text.frag, edit those instead */
+EmbeddedShader embeddedShaders[] = {
+    {"Sample_GL.vert", R"GLSL(
+#version 330 core
+
+// input data : sent from main program
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 1) in vec3 vertexColor;
+// per-instance data : x = rotation (radians), yz = offset
+// Left disabled for ordinary draws, where it reads as zero
+layout (location = 2) in vec3 instanceData;
+// per-instance depth layer, keeps batched draws in submission order
+layout (location = 3) in float instanceDepth;
+
+// View-projection, shared by every program and uploaded once per frame
+layout (std140) uniform Camera {
+    mat4 VP;
+};
+// Model matrix of unbatched draws (identity when the model comes per instance)
+uniform mat4 Model;
+
+// output data : used by fragment shader
+out vec3 fragColor;
+
+void main ()
+{
+    // Rotate and offset this copy of the model (identity when not instanced)
+    float c = cos(instanceData.x), s = sin(instanceData.x);
+    vec2 p = mat2(c, s, -s, c) * vertexPosition.xy + instanceData.yz;
+
+    vec4 v = vec4(p, vertexPosition.z + instanceDepth, 1); // Transform an homogeneous 4D vector
+
+    // The color of each vertex will be interpolated
+    // to produce the color of each fragment
+    fragColor = vertexColor;
+
+    // Output position of the vertex, in clip space : VP * Model * position
+    gl_Position = VP * Model * v;
+}
+)GLSL"},
+    {"Sample_GL.frag", R"GLSL(
+#version 330 core
+
+// Interpolated values from the vertex shaders
+in vec3 fragColor;
+
+// output data
+out vec3 color;
+
+void main()
+{
+    // Output color = color specified in the vertex shader,
+    // interpolated between all 3 surrounding vertices of the triangle
+    color = fragColor;
+}
+)GLSL"},
+    {"Text.vert", R"GLSL(
+#version 330 core
+
+// Glyph quads from bitmaptext.h, in pixels from the top left corner of the viewport
+layout (location = 0) in vec2 vertexPosition;
+// position in the font atlas
+layout (location = 1) in vec2 vertexUV;
+layout (location = 2) in vec3 vertexColor;
+
+// Viewport size in pixels
+uniform vec2 Viewport;
+
+out vec2 fragUV;
+out vec3 fragColor;
+
+void main ()
+{
+    fragUV = vertexUV;
+    fragColor = vertexColor;
+
+    // Pixels to clip space, y down
+    gl_Position = vec4(2 * vertexPosition.x / Viewport.x - 1, 1 - 2 * vertexPosition.y / Viewport.y, 0, 1);
+}
+)GLSL"},
+    {"Text.frag", R"GLSL(
+#version 330 core
+
+in vec2 fragUV;
+in vec3 fragColor;
+
+// One channel font atlas, lit texels are 1
+uniform sampler2D Atlas;
+
+out vec3 color;
+
+void main()
+{
+    // Only the glyph's own pixels are drawn, so no blending is needed
+    if (texture(Atlas, fragUV).r < 0.5)
+        discard;
+    color = fragColor;
+}
+)GLSL"},
+    {NULL, NULL}
+};
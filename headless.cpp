@@ -0,0 +1,154 @@
+/* The GLFW sample's simulation with no window or GL : fires shots from the command line and
+   prints where every body ends up. Results go to stdout.
+
+   headless [-shots N] [-angle A] [-angle-step dA] [-speed U] [-speed-step dU] [-steps S]
+   headless -check-drag
+
+   Shot k is fired at angle A+k*dA degrees with launch speed U+k*dU (the sample's u, 20 at full
+   power) and stepped S times.
+
+   -check-drag holds the batched drag trajectory of physics.h to the bounds it states, on the
+   vector path this build has (AVX2 with -mavx2, SSE2 on other x86-64 builds), and exits with
+   failure if any is exceeded. */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "physics.h"
+#include "simulation.h"
+
+#define DRAG_CHECK_EXPM1 1e-7       // relative error of dragExpm1()
+#define DRAG_CHECK_EXP 6e-8         // distance of 1 + dragExpm1(x) from exp(x)
+#define DRAG_CHECK_TRAJECTORY 1e-6  // dragTrajectory() against the reference, over the size of the terms each component sums
+
+float checkRandom(float low, float high)
+{
+    return low + (high-low)*(rand()/(float)RAND_MAX);
+}
+
+/* Number of bounds dragExpm1() and dragTrajectory() exceed, each printed with its worst case */
+int checkDragKernel()
+{
+    int failures = 0;
+
+    // The exp against double precision, over the clamped range and densely near 0
+    double worstExpm1 = 0, worstExp = 0;
+    for (int k=0; k<4000000; k++) {
+        float x = k < 2000000 ? -87.0f*k/2000000 : -0.01f*(k-2000000)/2000000;
+        double m = expm1((double)x), a = dragExpm1(x);
+        if (m == 0) {
+            if (a != 0)
+                worstExpm1 = HUGE_VAL;
+            continue;
+        }
+        worstExpm1 = fmax(worstExpm1, fabs(a-m)/fabs(m));
+        worstExp = fmax(worstExp, fabs((double)(1.0f+(float)a) - exp((double)x)));
+    }
+    printf("dragExpm1 relative error %.3g, bound %g\n", worstExpm1, DRAG_CHECK_EXPM1);
+    printf("1 + dragExpm1 error %.3g, bound %g\n", worstExp, DRAG_CHECK_EXP);
+    failures += (worstExpm1 > DRAG_CHECK_EXPM1) + (worstExp > DRAG_CHECK_EXP);
+
+    // Batches of every length up to 17 end in each kind of tail, 4099 runs many vector blocks
+    const float K[] = {0.05f, 0.3f, 1.0f, 3.0f};
+    const int lengths = 18;
+    double worstTrajectory = 0;
+    int laneMismatches = 0;
+    srand(1);
+    for (int k=0; k<(int)(sizeof(K)/sizeof(K[0])); k++)
+        for (int length=0; length<lengths; length++) {
+            int n = length < lengths-1 ? length+1 : 4099;
+            std::vector<float> startX(n), startY(n), V0x(n), V0y(n), M(n), T(n);
+            for (int i=0; i<n; i++) {
+                startX[i] = checkRandom(-400, 400);
+                startY[i] = checkRandom(-300, 300);
+                V0x[i] = checkRandom(-60, 60);
+                V0y[i] = checkRandom(-60, 60);
+                M[i] = checkRandom(1, 1000);
+                T[i] = i%3 ? checkRandom(0, 1000) : checkRandom(0, 1); // short times are where 1-e cancels
+            }
+            std::vector<float> batch[4], reference[4];
+            for (int c=0; c<4; c++) {
+                batch[c].resize(n);
+                reference[c].resize(n);
+            }
+            dragTrajectory(n, &startX[0], &startY[0], &V0x[0], &V0y[0], &M[0], &T[0], K[k], ADG,
+                           &batch[0][0], &batch[1][0], &batch[2][0], &batch[3][0]);
+            dragTrajectoryReference(n, &startX[0], &startY[0], &V0x[0], &V0y[0], &M[0], &T[0], K[k], ADG,
+                                    &reference[0][0], &reference[1][0], &reference[2][0], &reference[3][0]);
+            for (int i=0; i<n; i++) {
+                float one[4];  // the same body alone, through the scalar tail
+                dragTrajectory(1, &startX[i], &startY[i], &V0x[i], &V0y[i], &M[i], &T[i], K[k], ADG, one, one+1, one+2, one+3);
+                float mk = M[i]/K[k], terminal = mk*ADG;
+                double size[4] = {fabs(startX[i]) + fabs(mk*V0x[i]),
+                                  fabs(startY[i]) + fabs(mk*(V0y[i]+terminal)) + fabs(terminal*T[i]),
+                                  fabs(V0x[i]),
+                                  fabs(V0y[i]+terminal) + fabs(terminal)};
+                for (int c=0; c<4; c++) {
+                    worstTrajectory = fmax(worstTrajectory, fabs(batch[c][i]-reference[c][i])/size[c]);
+                    laneMismatches += one[c] != batch[c][i];
+                }
+            }
+        }
+    printf("dragTrajectory against the reference %.3g, bound %g\n", worstTrajectory, DRAG_CHECK_TRAJECTORY);
+    printf("lanes differing from the scalar tail %d\n", laneMismatches);
+    failures += (worstTrajectory > DRAG_CHECK_TRAJECTORY) + (laneMismatches > 0);
+    return failures;
+}
+
+int main (int argc, char** argv)
+{
+    int shots = 1, steps = 600;
+    float angle = 45.0f, angleStep = 0.0f;
+    float speed = 10.0f, speedStep = 0.0f;
+    bool checkDrag = false;
+
+    for (int i=1; i<argc; i++) {
+        if (i+1 < argc && !strcmp(argv[i], "-shots"))
+            shots = atoi(argv[++i]);
+        else if (i+1 < argc && !strcmp(argv[i], "-angle"))
+            angle = atof(argv[++i]);
+        else if (i+1 < argc && !strcmp(argv[i], "-angle-step"))
+            angleStep = atof(argv[++i]);
+        else if (i+1 < argc && !strcmp(argv[i], "-speed"))
+            speed = atof(argv[++i]);
+        else if (i+1 < argc && !strcmp(argv[i], "-speed-step"))
+            speedStep = atof(argv[++i]);
+        else if (i+1 < argc && !strcmp(argv[i], "-steps"))
+            steps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-check-drag"))
+            checkDrag = true;
+        else {
+            fprintf(stderr, "usage: %s [-shots N] [-angle A] [-angle-step dA] [-speed U] [-speed-step dU] [-steps S] | -check-drag\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (checkDrag) {
+        int failures = checkDragKernel();
+        printf(failures ? "drag check FAILED\n" : "drag check passed\n");
+        return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    for (int k=0; k<shots; k++) {
+        float a = angle+k*angleStep, u = speed+k*speedStep;
+
+        // One step aimed in the barrel, the way sample2D runs the frame before the click
+        createScene();
+        aimBall(a, u);
+        stepSimulation();
+        buttonPressed = 1;
+        for (int s=0; s<steps; s++)
+            stepSimulation();
+
+        printf("shot %d angle %g speed %g\n", k, a, u);
+        for (int i=0; i<bodyCount(bodies); i++)
+            printf("body %d x %.9g y %.9g velx %.9g vely %.9g timer %.9g\n",
+                   i, trans[i][0], trans[i][1], velx[i], vely[i], Timer[i]);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/* Development mode : rebuild the shader program when its files change, without restarting */
+/* Include after the GL loader (glad / GLEW) and shaderprograms.h */
+#ifndef HOTRELOAD_H
+#define HOTRELOAD_H
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "trace.h"
+
+/* The programs registered with shaderprograms.h are read from shaderDirectory, and every file
+   they pulled in (includes too) is watched: with inotify on Linux, by polling modification times
+   elsewhere. A change rebuilds them all, issuing the compiles and links at once, and nothing is
+   asked of the driver until it reports a link done (KHR/ARB_parallel_shader_compile), so drivers
+   that compile on their own threads never stall a frame. Without the extension the result is
+   read the frame after, which may wait for the compiler once. A program that links replaces the
+   old one; a failure prints the logs and keeps the old program running. */
+
+struct ShaderReload {
+    bool enabled;
+    bool rebuilding;              // some program has a build in flight
+    int fd;                       // inotify, -1 when polling
+    std::map<int, std::string> watches;      // inotify watch -> directory, relative to shaderDirectory
+    std::map<std::string, time_t> modified;  // polled files -> last modification time
+    ShaderReload() : enabled(false), rebuilding(false), fd(-1) {}
+} shaderReload;
+
+/* Watch every file the last load read */
+void watchShaderFiles()
+{
+    std::map<std::string, std::string>::iterator file;
+    for (file = shaderFiles.begin(); file != shaderFiles.end(); file++) {
+        std::string directory = file->first.substr(0, file->first.find_last_of('/')+1);
+        std::string path = std::string(shaderDirectory) + "/" + file->first;
+#ifdef __linux__
+        if (shaderReload.fd >= 0) {
+            int watch = inotify_add_watch(shaderReload.fd, (std::string(shaderDirectory) + "/" + directory).c_str(),
+                                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            if (watch >= 0)
+                shaderReload.watches[watch] = directory;
+            continue;
+        }
+#endif
+        struct stat info;
+        if (!stat(path.c_str(), &info))
+            shaderReload.modified[file->first] = info.st_mtime;
+    }
+}
+
+/* True if a watched file changed since the last call */
+bool shaderFilesChanged()
+{
+    bool changed = false;
+#ifdef __linux__
+    if (shaderReload.fd >= 0) {
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t n;
+        while ((n = read(shaderReload.fd, events, sizeof(events))) > 0) {
+            for (char* at = events; at < events+n; at += sizeof(struct inotify_event)+((struct inotify_event*) at)->len) {
+                const struct inotify_event* event = (const struct inotify_event*) at;
+                // Editors often save by renaming a new file over the old one, so go by name
+                if (event->len && shaderFiles.count(shaderReload.watches[event->wd]+event->name))
+                    changed = true;
+            }
+        }
+        return changed;
+    }
+#endif
+    std::map<std::string, time_t>::iterator file;
+    for (file = shaderReload.modified.begin(); file != shaderReload.modified.end(); file++) {
+        struct stat info;
+        if (!stat((std::string(shaderDirectory) + "/" + file->first).c_str(), &info) && info.st_mtime != file->second) {
+            file->second = info.st_mtime;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/* Issue the rebuild of every program, without waiting on any of it */
+void startShaderRebuild()
+{
+    TRACE_SCOPE("startShaderRebuild");
+    forgetShaderFiles();
+    shaderReload.rebuilding = false;
+    for (size_t i = 0; i < shaderPrograms.size(); i++) {
+        dropProgramBuild(shaderPrograms[i]);
+        if (issueProgramCompile(shaderPrograms[i]))
+            shaderReload.rebuilding = true;
+    }
+    for (size_t i = 0; i < shaderPrograms.size(); i++)
+        issueProgramLink(shaderPrograms[i]);
+    watchShaderFiles();  // includes may have changed
+}
+
+/* Swap in each program whose link is done */
+void finishShaderRebuild()
+{
+    shaderReload.rebuilding = false;
+    for (size_t i = 0; i < shaderPrograms.size(); i++) {
+        ShaderProgram& entry = shaderPrograms[i];
+        if (!entry.id)
+            continue;
+        if (!programBuildDone(entry)) {
+            shaderReload.rebuilding = true;
+            continue;
+        }
+        TRACE_SCOPE("finishShaderRebuild");
+        if (finishProgramBuild(entry))
+            printf("Reloaded %s and %s\n", entry.vertexPath, entry.fragmentPath);
+        else
+            fprintf(stderr, "Keeping the running program\n");
+    }
+}
+
+/* Watch the files of the programs built so far. Needs shaderDirectory set. */
+void startShaderReload()
+{
+    shaderReload.enabled = true;
+#ifdef __linux__
+    shaderReload.fd = inotify_init1(IN_NONBLOCK);
+#endif
+    watchShaderFiles();
+}
+
+/* Once a frame, before drawing with the programs */
+void pollShaderReload()
+{
+    if (!shaderReload.enabled)
+        return;
+    if (shaderFilesChanged())
+        startShaderRebuild();
+    else if (shaderReload.rebuilding)
+        finishShaderRebuild();
+}
+
+#endif
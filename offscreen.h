@@ -0,0 +1,244 @@
+/* Offscreen rendering shared by the GLFW and GLUT builds : a GL 3.3 core context with no window,
+   drawing into a framebuffer object that is read back into image files */
+/* Include after the GL loader (glad / GLEW). Needs EGL, so it is Linux only - on other systems
+   createOffscreenContext() reports that it is unavailable */
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if !defined(__APPLE__) && !defined(_WIN32)
+#define OFFSCREEN_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+/* The context runs on EGL with no surface at all: Mesa's surfaceless platform when it is there,
+   which needs neither a display nor a GPU (llvmpipe renders on the CPU), else the default
+   display. Everything draws into an FBO, so the image is the same size as the window would be.
+   GL entry points are looked up with getProcAddress() once the context is current. */
+
+struct Offscreen {
+    int width, height;
+    GLuint Framebuffer;
+    GLuint ColorBuffer, DepthBuffer;
+} offscreen = {0, 0, 0, 0, 0};
+
+/* Make a GL 3.3 core context current with no window. False if EGL cannot provide one. */
+bool createOffscreenContext()
+{
+#ifdef OFFSCREEN_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+#endif
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        fprintf(stderr, "Offscreen: no EGL display\n");
+        return false;
+    }
+
+    EGLint configAttribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    eglChooseConfig(display, configAttribs, &config, 1, &numConfigs);
+    eglBindAPI(EGL_OPENGL_API);
+
+    EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    // Surfaceless contexts need no config at all where EGL_KHR_no_config_context is supported
+    EGLContext context = eglCreateContext(display, numConfigs ? config : (EGLConfig) 0, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        fprintf(stderr, "Offscreen: no GL 3.3 core context (EGL error 0x%x)\n", eglGetError());
+        return false;
+    }
+    return true;
+#else
+    fprintf(stderr, "Offscreen: not available on this system\n");
+    return false;
+#endif
+}
+
+/* GL entry point lookup for the loader, valid once the offscreen context is current */
+void* getProcAddress(const char* name)
+{
+#ifdef OFFSCREEN_EGL
+    return (void*) eglGetProcAddress(name);
+#else
+    return NULL;
+#endif
+}
+
+/* Colour and depth renderbuffers of width x height, bound for drawing. Call after the loader. */
+bool createOffscreenFramebuffer(int width, int height)
+{
+    offscreen.width = width;
+    offscreen.height = height;
+    glGenFramebuffers(1, &offscreen.Framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreen.Framebuffer);
+
+    glGenRenderbuffers(1, &offscreen.ColorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreen.ColorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreen.ColorBuffer);
+
+    glGenRenderbuffers(1, &offscreen.DepthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreen.DepthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreen.DepthBuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Offscreen: framebuffer incomplete\n");
+        return false;
+    }
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+/* Framebuffer contents as RGB rows, top row first */
+std::vector<unsigned char> readFrame()
+{
+    int w = offscreen.width, h = offscreen.height;
+    std::vector<unsigned char> pixels(w*h*3), rows(w*h*3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+    for (int y = 0; y < h; y++)  // GL rows start at the bottom
+        memcpy(&rows[y*w*3], &pixels[(h-1-y)*w*3], w*3);
+    return rows;
+}
+
+/* Read the framebuffer back and write it as a binary PPM */
+bool writeFramePPM(const char* path)
+{
+    std::vector<unsigned char> rows = readFrame();
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Offscreen: cannot write %s\n", path);
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", offscreen.width, offscreen.height);
+    fwrite(&rows[0], 1, rows.size(), file);
+    fclose(file);
+    return true;
+}
+
+/* PNG without zlib : the image data goes in stored (uncompressed) deflate blocks, so files are
+   about the size of a PPM but open in any viewer */
+
+unsigned int pngCrc(unsigned int crc, const unsigned char* data, int n)
+{
+    static unsigned int table[256];
+    if (!table[1]) {
+        for (unsigned int i = 0; i < 256; i++) {
+            unsigned int c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+    for (int i = 0; i < n; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+void pngPut32(std::vector<unsigned char>& out, unsigned int v)
+{
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+void pngChunk(FILE* file, const char* type, const std::vector<unsigned char>& data)
+{
+    std::vector<unsigned char> chunk;
+    pngPut32(chunk, data.size());
+    chunk.insert(chunk.end(), type, type+4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    unsigned int crc = pngCrc(0xFFFFFFFFu, &chunk[4], chunk.size()-4) ^ 0xFFFFFFFFu;
+    pngPut32(chunk, crc);
+    fwrite(&chunk[0], 1, chunk.size(), file);
+}
+
+/* Read the framebuffer back and write it as an 8 bit RGB PNG */
+bool writeFramePNG(const char* path)
+{
+    int w = offscreen.width, h = offscreen.height;
+    std::vector<unsigned char> rows = readFrame();
+
+    // Each scanline starts with filter type 0 (none)
+    std::vector<unsigned char> raw;
+    raw.reserve(h*(w*3+1));
+    for (int y = 0; y < h; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rows.begin()+y*w*3, rows.begin()+(y+1)*w*3);
+    }
+
+    std::vector<unsigned char> idat;
+    idat.push_back(0x78);  // zlib header : deflate, 32K window, no preset dictionary
+    idat.push_back(0x01);
+    unsigned int a = 1, b = 0;  // Adler-32 of the uncompressed data
+    for (size_t at = 0; at < raw.size(); ) {
+        int n = raw.size()-at < 65535 ? raw.size()-at : 65535;
+        idat.push_back(at+n == raw.size());  // final block flag, stored type
+        idat.push_back(n & 0xFF);
+        idat.push_back(n >> 8);
+        idat.push_back(~n & 0xFF);
+        idat.push_back((~n >> 8) & 0xFF);
+        for (int i = 0; i < n; i++) {
+            unsigned char c = raw[at+i];
+            idat.push_back(c);
+            a = (a+c) % 65521;
+            b = (b+a) % 65521;
+        }
+        at += n;
+    }
+    pngPut32(idat, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    pngPut32(header, w);
+    pngPut32(header, h);
+    header.push_back(8);  // bit depth
+    header.push_back(2);  // colour type RGB
+    header.push_back(0);  // deflate
+    header.push_back(0);  // adaptive filtering
+    header.push_back(0);  // not interlaced
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Offscreen: cannot write %s\n", path);
+        return false;
+    }
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    fwrite(signature, 1, 8, file);
+    pngChunk(file, "IHDR", header);
+    pngChunk(file, "IDAT", idat);
+    pngChunk(file, "IEND", std::vector<unsigned char>());
+    fclose(file);
+    return true;
+}
+
+/* PNG when the path ends in .png, PPM otherwise */
+bool writeFrame(const char* path)
+{
+    size_t n = strlen(path);
+    if (n >= 4 && !strcmp(path+n-4, ".png"))
+        return writeFramePNG(path);
+    return writeFramePPM(path);
+}
+
+#endif
@@ -0,0 +1,751 @@
+/* Collision helpers shared by the GLFW and GLUT builds, and by the headless build - no GL in here */
+/* Include after glm */
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+/* The narrowphase uses AVX (8 circles a step) when built with -mavx / -mavx2 / -march=native,
+   SSE2 (4 a step) on any other x86-64 build and plain scalar code elsewhere. The drag trajectory
+   goes 8 bodies a step with AVX2, 4 with SSE2. */
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/* Lane of the lowest bit set in a non-zero movemask */
+int lowestLane(int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long lane;
+    _BitScanForward(&lane, mask);
+    return (int)lane;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+/* A body's collision shape is a list of circles ((offset along, offset across), radius), the offset
+   following the body's rotation - the tup of the sample code */
+typedef std::pair< std::pair<float,float>, float > CollisionCircle;
+
+/*--------------------------------------------------------- WORLD-SPACE CIRCLES ---------------------------------------------------------*/
+
+/* Each body keeps its circles placed in the world, rebuilt only when its position, rotation or
+   shape changed since the last use. The trig runs once per body per step and the narrowphase is
+   plain multiply-add. Offsets are (along, across) the body's rotation. */
+
+struct WorldCircles {
+    glm::vec3 position;                 // placement the lists below were built for
+    float rotation;
+    std::vector<CollisionCircle> shape;
+    bool valid;
+    std::vector<float> x, y, r;         // world centre and radius of each circle
+};
+
+/* Angles are kept in degrees, wrapped once into [0,360) before use */
+float formatAngle(float A)
+{
+    if(A<0.0f)
+        return A+360.0f;
+    if(A>=360.0f)
+        return A-360.0f;
+    return A;
+}
+float D2R(float A)
+{
+    return (A*M_PI)/180.0f;
+}
+
+const WorldCircles& updateWorldCircles(WorldCircles& world, const glm::vec3& position, float rotation, const std::vector<CollisionCircle>& circles)
+{
+    if (world.valid && world.position == position && world.rotation == rotation && world.shape == circles)
+        return world;
+    world.position = position;
+    world.rotation = rotation;
+    world.shape = circles;
+    world.valid = true;
+
+    float A = D2R(formatAngle(rotation));
+    float c = std::cos(A), s = std::sin(A);
+    int n = circles.size();
+    world.x.resize(n);
+    world.y.resize(n);
+    world.r.resize(n);
+    for (int k=0; k<n; k++) {
+        float along = circles[k].first.first, across = circles[k].first.second;
+        world.x[k] = position[0] + along*c - across*s;
+        world.y[k] = position[1] + along*s + across*c;
+        world.r[k] = circles[k].second;
+    }
+    return world;
+}
+
+/* First of the n circles (x[], y[], r[]) touching the circle (cx,cy,cr), or -1. Vector lanes do
+   exactly the scalar arithmetic, so every path finds the same contact */
+int firstTouching(float cx, float cy, float cr, const float* x, const float* y, const float* r, int n)
+{
+    int l = 0;
+#if defined(__AVX__)
+    __m256 X8 = _mm256_set1_ps(cx), Y8 = _mm256_set1_ps(cy), R8 = _mm256_set1_ps(cr);
+    for (; l+8 <= n; l += 8) {
+        __m256 dx = _mm256_sub_ps(X8, _mm256_loadu_ps(x+l));
+        __m256 dy = _mm256_sub_ps(Y8, _mm256_loadu_ps(y+l));
+        __m256 rsum = _mm256_add_ps(R8, _mm256_loadu_ps(r+l));
+        __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        int hits = _mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(rsum, rsum), _CMP_LE_OQ));
+        if (hits)
+            return l + lowestLane(hits);
+    }
+#endif
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+    __m128 X4 = _mm_set1_ps(cx), Y4 = _mm_set1_ps(cy), R4 = _mm_set1_ps(cr);
+    for (; l+4 <= n; l += 4) {
+        __m128 dx = _mm_sub_ps(X4, _mm_loadu_ps(x+l));
+        __m128 dy = _mm_sub_ps(Y4, _mm_loadu_ps(y+l));
+        __m128 rsum = _mm_add_ps(R4, _mm_loadu_ps(r+l));
+        __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        int hits = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_mul_ps(rsum, rsum)));
+        if (hits)
+            return l + lowestLane(hits);
+    }
+#endif
+    for (; l < n; l++) {
+        float dx = cx-x[l], dy = cy-y[l];
+        float rsum = cr+r[l];
+        if (dx*dx + dy*dy <= rsum*rsum)
+            return l;
+    }
+    return -1;
+}
+
+/* Narrowphase : whether any circle of a touches any circle of b. The longer list is the one
+   swept with vectors (a floor against a projectile); k and l, when given, receive the first
+   contact found, as indices into a and b */
+bool firstContact(const WorldCircles& a, const WorldCircles& b, int* k, int* l)
+{
+    bool swap = a.x.size() > b.x.size();
+    const WorldCircles& outer = swap ? b : a;
+    const WorldCircles& inner = swap ? a : b;
+    int n = inner.x.size();
+    if (n == 0)
+        return false;
+    for (int i=0; i<(int)outer.x.size(); i++) {
+        int j = firstTouching(outer.x[i], outer.y[i], outer.r[i], &inner.x[0], &inner.y[0], &inner.r[0], n);
+        if (j < 0)
+            continue;
+        if (k)
+            *k = swap ? j : i;
+        if (l)
+            *l = swap ? i : j;
+        return true;
+    }
+    return false;
+}
+
+bool circlesOverlap(const WorldCircles& a, const WorldCircles& b)
+{
+    return firstContact(a, b, NULL, NULL);
+}
+
+/*--------------------------------------------------------- SWEPT CIRCLES ---------------------------------------------------------*/
+
+/* Continuous collision : a moves by s*(dx,dy) while b stays put (pass the relative motion when both
+   move), and for every circle pair |p + s*d| = ra+rb is a quadratic in s, solved in closed form.
+   Its first root is when the pair starts touching and its second when it stops, so the contact
+   and the separation of two bodies come out of one pass over their k x l pairs, where stepping
+   and re-testing takes an unbounded number of narrowphase runs and a step longer than the
+   bodies are thick misses the contact altogether. skin shrinks the radius sums for contacts, so
+   a body put at its contact overlaps by skin and the narrowphase sees it, and grows them for
+   separations, so a body pushed out is clear of the other despite rounding. */
+
+/* Earliest s in [0,1] at which a, clear of b, comes to overlap it by skin, or -1 if it does not.
+   Also -1 when they already overlap, which is for the collision responses to sort out. */
+float sweepContact(const WorldCircles& a, const WorldCircles& b, float dx, float dy, float skin)
+{
+    float dd = dx*dx + dy*dy;
+    float first = 2.0f;
+    for (int k=0; k<(int)a.x.size(); k++)
+        for (int l=0; l<(int)b.x.size(); l++) {
+            float px = a.x[k]-b.x[l], py = a.y[k]-b.y[l];
+            float rsum = a.r[k]+b.r[l];
+            if (px*px + py*py <= rsum*rsum)
+                return -1.0f;
+            rsum -= skin;
+            float c = px*px + py*py - rsum*rsum;
+            float pd = px*dx + py*dy;
+            if (rsum <= 0.0f || pd >= 0.0f)
+                continue;  // not closing in
+            float disc = pd*pd - dd*c;
+            if (disc < 0.0f)
+                continue;  // passes by
+            float s = (-pd - std::sqrt(disc)) / dd;
+            first = s < first ? s : first;
+        }
+    return first <= 1.0f ? first : -1.0f;
+}
+
+/* Least s >= 0 at which a is clear of b by skin, counting the pairs overlapping now: 0 if none
+   does, -1 if some do and there is no motion to part them */
+float sweepSeparation(const WorldCircles& a, const WorldCircles& b, float dx, float dy, float skin)
+{
+    float dd = dx*dx + dy*dy;
+    float last = 0.0f;
+    for (int k=0; k<(int)a.x.size(); k++)
+        for (int l=0; l<(int)b.x.size(); l++) {
+            float px = a.x[k]-b.x[l], py = a.y[k]-b.y[l];
+            float rsum = a.r[k]+b.r[l]+skin;
+            float c = px*px + py*py - rsum*rsum;
+            if (c >= 0.0f)
+                continue;
+            if (dd == 0.0f)
+                return -1.0f;
+            float pd = px*dx + py*dy;
+            float s = (-pd + std::sqrt(pd*pd - dd*c)) / dd;  // c < 0, so one root on each side of 0
+            last = s > last ? s : last;
+        }
+    return last;
+}
+
+/*--------------------------------------------------------- DRAG TRAJECTORY ---------------------------------------------------------*/
+
+/* A body launched from the origin with velocity V0 and mass M, slowed by air friction K times its
+   velocity and pulled down by gravity G, in closed form. With e = exp(-(K/M)T) after time T:
+       x = (M/K) V0x (1-e)                     vx = V0x e
+       y = (M/K)(V0y + MG/K)(1-e) - MGT/K      vy = (V0y + MG/K) e - MG/K
+   The functions below take one component each and each computes its own exp; they are the
+   reference the batched dragTrajectory() is checked against. */
+
+float EKMT(float K,float M,float T)
+{
+    return exp(-((K/M)*T));
+}
+float xvel(float V0,float K,float M,float T)
+{
+    return V0*EKMT(K,M,T);
+}
+float xdis(float V0,float K,float M,float T)
+{
+    return ((M/K)*V0)*(1.0f-EKMT(K,M,T));
+}
+float yvel(float V0,float K,float M,float T,float G)
+{
+    return ((V0+((M*G)/K))*EKMT(K,M,T))-((M*G)/K);
+}
+float ydis(float V0,float K,float M,float T,float G)
+{
+    return ((M/K)*(V0+((M*G)/K))*(1-EKMT(K,M,T)))-((M*G*T)/K);
+}
+
+/* exp(x)-1 for x <= 0, clamped to [-87,0] (where e is 0 to float precision). x = n ln2 + r with
+   |r| <= ln2/2, and exp(r)-1 = r + r^2 P(r) with Cephes' expf polynomial. Keeping e-1 rather
+   than e means 1-e for a short time is not the difference of two nearly equal floats: its
+   relative error stays within 1e-7 over the whole range, and 1 + it is within 6e-8 of e. The
+   vector versions do exactly these operations, so every lane and the scalar tail agree.
+   headless -check-drag checks all of this. */
+#define DRAG_EXP_LOG2E 1.44269504f
+#define DRAG_EXP_LN2_HI 0.693359375f  // ln2 = HI - LO, HI with few enough bits that n*HI is exact
+#define DRAG_EXP_LN2_LO 2.12194440e-4f
+
+float dragExpm1(float x)
+{
+    x = x < 0.0f ? x : 0.0f;      // the order of _mm_min_ps / _mm_max_ps, NaN included
+    x = x > -87.0f ? x : -87.0f;
+    float n = std::nearbyint(x*DRAG_EXP_LOG2E);
+    float r = (x - n*DRAG_EXP_LN2_HI) + n*DRAG_EXP_LN2_LO;
+    float p = ((((1.9875691500e-4f*r + 1.3981999507e-3f)*r + 8.3334519073e-3f)*r + 4.1665795894e-2f)*r + 1.6666665459e-1f)*r + 5.0000001201e-1f;
+    float q = r + (r*r)*p;
+    float scale = std::ldexp(1.0f, (int)n);
+    return scale*q + (scale - 1.0f);
+}
+
+#if defined(__AVX2__)
+__m256 dragExpm1(__m256 x)
+{
+    x = _mm256_max_ps(_mm256_min_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(-87.0f));
+    __m256i ni = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(DRAG_EXP_LOG2E)));
+    __m256 n = _mm256_cvtepi32_ps(ni);
+    __m256 r = _mm256_add_ps(_mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(DRAG_EXP_LN2_HI))), _mm256_mul_ps(n, _mm256_set1_ps(DRAG_EXP_LN2_LO)));
+    __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.3981999507e-3f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(8.3334519073e-3f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(4.1665795894e-2f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.6666665459e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(5.0000001201e-1f));
+    __m256 q = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r), p));
+    __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(ni, _mm256_set1_epi32(127)), 23));
+    return _mm256_add_ps(_mm256_mul_ps(scale, q), _mm256_sub_ps(scale, _mm256_set1_ps(1.0f)));
+}
+#endif
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+__m128 dragExpm1(__m128 x)
+{
+    x = _mm_max_ps(_mm_min_ps(x, _mm_setzero_ps()), _mm_set1_ps(-87.0f));
+    __m128i ni = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(DRAG_EXP_LOG2E)));
+    __m128 n = _mm_cvtepi32_ps(ni);
+    __m128 r = _mm_add_ps(_mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(DRAG_EXP_LN2_HI))), _mm_mul_ps(n, _mm_set1_ps(DRAG_EXP_LN2_LO)));
+    __m128 p = _mm_set1_ps(1.9875691500e-4f);
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.3981999507e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(8.3334519073e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(4.1665795894e-2f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.6666665459e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(5.0000001201e-1f));
+    __m128 q = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r), p));
+    __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(ni, _mm_set1_epi32(127)), 23));
+    return _mm_add_ps(_mm_mul_ps(scale, q), _mm_sub_ps(scale, _mm_set1_ps(1.0f)));
+}
+#endif
+
+/* Positions and velocities of n bodies at their times T[], from their start points, launch
+   velocities and masses, all as parallel arrays (the body store's own arrays will do). One exp
+   per body serves all four components, and 8 (AVX2) or 4 (SSE2) bodies go through it at once. */
+void dragTrajectory(int n, const float* startX, const float* startY, const float* V0x, const float* V0y,
+                    const float* M, const float* T, float K, float G, float* x, float* y, float* vx, float* vy)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    __m256 K8 = _mm256_set1_ps(K), G8 = _mm256_set1_ps(G), one8 = _mm256_set1_ps(1.0f);
+    for (; i+8 <= n; i += 8) {
+        __m256 t = _mm256_loadu_ps(T+i);
+        __m256 mk = _mm256_div_ps(_mm256_loadu_ps(M+i), K8);
+        __m256 terminal = _mm256_mul_ps(mk, G8);
+        __m256 em1 = dragExpm1(_mm256_sub_ps(_mm256_setzero_ps(), _mm256_div_ps(t, mk)));
+        __m256 e = _mm256_add_ps(one8, em1), d = _mm256_sub_ps(_mm256_setzero_ps(), em1);
+        __m256 ux = _mm256_loadu_ps(V0x+i), uy = _mm256_add_ps(_mm256_loadu_ps(V0y+i), terminal);
+        _mm256_storeu_ps(x+i, _mm256_add_ps(_mm256_loadu_ps(startX+i), _mm256_mul_ps(_mm256_mul_ps(mk, ux), d)));
+        _mm256_storeu_ps(y+i, _mm256_add_ps(_mm256_loadu_ps(startY+i), _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(mk, uy), d), _mm256_mul_ps(terminal, t))));
+        _mm256_storeu_ps(vx+i, _mm256_mul_ps(ux, e));
+        _mm256_storeu_ps(vy+i, _mm256_sub_ps(_mm256_mul_ps(uy, e), terminal));
+    }
+#endif
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+    __m128 K4 = _mm_set1_ps(K), G4 = _mm_set1_ps(G), one4 = _mm_set1_ps(1.0f);
+    for (; i+4 <= n; i += 4) {
+        __m128 t = _mm_loadu_ps(T+i);
+        __m128 mk = _mm_div_ps(_mm_loadu_ps(M+i), K4);
+        __m128 terminal = _mm_mul_ps(mk, G4);
+        __m128 em1 = dragExpm1(_mm_sub_ps(_mm_setzero_ps(), _mm_div_ps(t, mk)));
+        __m128 e = _mm_add_ps(one4, em1), d = _mm_sub_ps(_mm_setzero_ps(), em1);
+        __m128 ux = _mm_loadu_ps(V0x+i), uy = _mm_add_ps(_mm_loadu_ps(V0y+i), terminal);
+        _mm_storeu_ps(x+i, _mm_add_ps(_mm_loadu_ps(startX+i), _mm_mul_ps(_mm_mul_ps(mk, ux), d)));
+        _mm_storeu_ps(y+i, _mm_add_ps(_mm_loadu_ps(startY+i), _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(mk, uy), d), _mm_mul_ps(terminal, t))));
+        _mm_storeu_ps(vx+i, _mm_mul_ps(ux, e));
+        _mm_storeu_ps(vy+i, _mm_sub_ps(_mm_mul_ps(uy, e), terminal));
+    }
+#endif
+    for (; i < n; i++) {
+        float mk = M[i]/K, terminal = mk*G;
+        float em1 = dragExpm1(0.0f - T[i]/mk);
+        float e = 1.0f + em1, d = 0.0f - em1;
+        float ux = V0x[i], uy = V0y[i] + terminal;
+        x[i] = startX[i] + (mk*ux)*d;
+        y[i] = startY[i] + ((mk*uy)*d - terminal*T[i]);
+        vx[i] = ux*e;
+        vy[i] = uy*e - terminal;
+    }
+}
+
+/* dragTrajectory() one component at a time with the reference functions, for checking it.
+   headless -check-drag holds every component of dragTrajectory() to within 1e-6 of the size of
+   the terms it sums, which allows for the rounding of the reference as well as its own. */
+void dragTrajectoryReference(int n, const float* startX, const float* startY, const float* V0x, const float* V0y,
+                             const float* M, const float* T, float K, float G, float* x, float* y, float* vx, float* vy)
+{
+    for (int i=0; i<n; i++) {
+        x[i] = startX[i] + xdis(V0x[i], K, M[i], T[i]);
+        y[i] = startY[i] + ydis(V0y[i], K, M[i], T[i], G);
+        vx[i] = xvel(V0x[i], K, M[i], T[i]);
+        vy[i] = yvel(V0y[i], K, M[i], T[i], G);
+    }
+}
+
+/*--------------------------------------------------------- BROADPHASE ---------------------------------------------------------*/
+
+/* Uniform grid : every body's bounding box is binned into square cells and bodies sharing a cell
+   become candidate pairs for the narrowphase (checkCollision). The cells are a counting-sorted
+   array, so a rebuild is a few linear passes that reuse the buffers of the previous step. A pair
+   overlapping in several cells is only reported by the cell holding the lower-left corner of the
+   overlap of the two boxes, so no pair comes out twice. */
+
+#define BROADPHASE_MAX_CELLS 65536 // cells grow past cellSize when the bodies are spread wider
+
+struct Bounds {
+    float minX, minY, maxX, maxY;
+};
+
+struct BroadphaseGrid {
+    float cellSize;                             // requested cell size, world units
+    float cell;                                 // cell size of the last build
+    float originX, originY;
+    int columns, rows;
+    std::vector<Bounds> bounds;                 // per body, empty (min > max) without circles
+    std::vector<int> cellStart;                 // columns*rows+1 offsets into cellBodies
+    std::vector<int> cellBodies;                // body indices, ascending within a cell
+    std::vector< std::pair<int,int> > pairs;    // candidate pairs i<j, sorted
+    std::vector<int> pairStart;                 // pairs of body i are pairs[pairStart[i]..pairStart[i+1])
+};
+
+/* Empty grid of cells of cellSize, built by the first buildBroadphase() */
+BroadphaseGrid broadphaseGrid(float cellSize)
+{
+    BroadphaseGrid grid;
+    grid.cellSize = cellSize;
+    grid.cell = cellSize;
+    grid.originX = grid.originY = 0.0f;
+    grid.columns = grid.rows = 0;
+    return grid;
+}
+
+/* Box around a body's placed circles, grown by margin */
+Bounds bodyBounds(const WorldCircles& world, float margin)
+{
+    Bounds box = {1.0f, 1.0f, 0.0f, 0.0f};
+    if (world.x.empty())
+        return box;
+    box.minX = box.minY = HUGE_VALF;
+    box.maxX = box.maxY = -HUGE_VALF;
+    for (int k=0; k<(int)world.x.size(); k++) {
+        float x = world.x[k], y = world.y[k];
+        float r = world.r[k] + margin;
+        box.minX = x-r < box.minX ? x-r : box.minX;
+        box.minY = y-r < box.minY ? y-r : box.minY;
+        box.maxX = x+r > box.maxX ? x+r : box.maxX;
+        box.maxY = y+r > box.maxY ? y+r : box.maxY;
+    }
+    return box;
+}
+
+int cellColumn(const BroadphaseGrid& grid, float x)
+{
+    int column = (int)((x - grid.originX) / grid.cell);
+    return column < 0 ? 0 : (column >= grid.columns ? grid.columns-1 : column);
+}
+
+int cellRow(const BroadphaseGrid& grid, float y)
+{
+    int row = (int)((y - grid.originY) / grid.cell);
+    return row < 0 ? 0 : (row >= grid.rows ? grid.rows-1 : row);
+}
+
+int comparePairs(const void* p, const void* q)
+{
+    const std::pair<int,int>& a = *(const std::pair<int,int>*)p;
+    const std::pair<int,int>& b = *(const std::pair<int,int>*)q;
+    if (a.first != b.first)
+        return a.first - b.first;
+    return a.second - b.second;
+}
+
+/* Bin bodies 0..n-1 and collect the pairs whose boxes (grown by margin) overlap, refreshing
+   the world circles of every body on the way */
+void buildBroadphase(BroadphaseGrid& grid, int n, const glm::vec3* position, const float* rotation, const std::vector<CollisionCircle>* circles, WorldCircles* world, float margin)
+{
+    grid.bounds.resize(n);
+    grid.pairs.clear();
+    grid.pairStart.assign(n+1, 0);
+
+    // World extent of everything that can collide
+    float minX = HUGE_VALF, minY = HUGE_VALF, maxX = -HUGE_VALF, maxY = -HUGE_VALF;
+    for (int i=0; i<n; i++) {
+        Bounds& box = grid.bounds[i] = bodyBounds(updateWorldCircles(world[i], position[i], rotation[i], circles[i]), margin);
+        if (box.minX > box.maxX)
+            continue;
+        minX = box.minX < minX ? box.minX : minX;
+        minY = box.minY < minY ? box.minY : minY;
+        maxX = box.maxX > maxX ? box.maxX : maxX;
+        maxY = box.maxY > maxY ? box.maxY : maxY;
+    }
+    if (minX > maxX)
+        return;
+
+    grid.cell = grid.cellSize > 0.0f ? grid.cellSize : 64.0f;
+    while ((maxX-minX)/grid.cell * (maxY-minY)/grid.cell > BROADPHASE_MAX_CELLS)
+        grid.cell *= 2.0f;
+    grid.originX = minX;
+    grid.originY = minY;
+    grid.columns = (int)((maxX-minX)/grid.cell) + 1;
+    grid.rows = (int)((maxY-minY)/grid.cell) + 1;
+    int cells = grid.columns*grid.rows;
+
+    // Counting sort of (cell, body) : count, prefix sum, fill
+    grid.cellStart.assign(cells+1, 0);
+    for (int pass=0; pass<2; pass++) {
+        std::vector<int> fill;
+        if (pass == 1) {
+            for (int c=0; c<cells; c++)
+                grid.cellStart[c+1] += grid.cellStart[c];
+            grid.cellBodies.resize(grid.cellStart[cells]);
+            fill.assign(grid.cellStart.begin(), grid.cellStart.end()-1);
+        }
+        for (int i=0; i<n; i++) {
+            const Bounds& box = grid.bounds[i];
+            if (box.minX > box.maxX)
+                continue;
+            int c0 = cellColumn(grid, box.minX), c1 = cellColumn(grid, box.maxX);
+            int r0 = cellRow(grid, box.minY), r1 = cellRow(grid, box.maxY);
+            for (int r=r0; r<=r1; r++)
+                for (int c=c0; c<=c1; c++) {
+                    if (pass == 0)
+                        grid.cellStart[r*grid.columns+c+1]++;
+                    else
+                        grid.cellBodies[fill[r*grid.columns+c]++] = i;
+                }
+        }
+    }
+
+    // Pairs sharing a cell, reported once by the cell of the lower-left corner of their overlap
+    for (int r=0; r<grid.rows; r++)
+        for (int c=0; c<grid.columns; c++) {
+            int cell = r*grid.columns+c;
+            for (int a=grid.cellStart[cell]; a<grid.cellStart[cell+1]; a++)
+                for (int b=a+1; b<grid.cellStart[cell+1]; b++) {
+                    int i = grid.cellBodies[a], j = grid.cellBodies[b];
+                    const Bounds& p = grid.bounds[i];
+                    const Bounds& q = grid.bounds[j];
+                    if (p.maxX < q.minX || q.maxX < p.minX || p.maxY < q.minY || q.maxY < p.minY)
+                        continue;
+                    float cornerX = p.minX > q.minX ? p.minX : q.minX;
+                    float cornerY = p.minY > q.minY ? p.minY : q.minY;
+                    if (cellColumn(grid, cornerX) != c || cellRow(grid, cornerY) != r)
+                        continue;
+                    grid.pairs.push_back(std::make_pair(i, j));
+                }
+        }
+
+    if (!grid.pairs.empty())
+        qsort(&grid.pairs[0], grid.pairs.size(), sizeof(grid.pairs[0]), comparePairs);
+    for (int p=0; p<(int)grid.pairs.size(); p++)
+        grid.pairStart[grid.pairs[p].first+1]++;
+    for (int i=0; i<n; i++)
+        grid.pairStart[i+1] += grid.pairStart[i];
+}
+
+/* Whether the last build made i and j a candidate pair */
+bool mayCollide(const BroadphaseGrid& grid, int i, int j)
+{
+    if (i > j) {
+        int t = i; i = j; j = t;
+    }
+    if (j >= (int)grid.pairStart.size()-1)
+        return false;
+    for (int p=grid.pairStart[i]; p<grid.pairStart[i+1]; p++)
+        if (grid.pairs[p].second == j)
+            return true;
+    return false;
+}
+
+/* Append to found every body whose box from the last build overlaps box, each once : like the
+   pairs, a body is reported by the cell holding the lower-left corner of the overlap */
+void bodiesInBox(const BroadphaseGrid& grid, const Bounds& box, std::vector<int>& found)
+{
+    if (grid.columns <= 0 || grid.rows <= 0 || grid.cellStart.empty())
+        return;
+    int c0 = cellColumn(grid, box.minX), c1 = cellColumn(grid, box.maxX);
+    int r0 = cellRow(grid, box.minY), r1 = cellRow(grid, box.maxY);
+    for (int r=r0; r<=r1; r++)
+        for (int c=c0; c<=c1; c++) {
+            int cell = r*grid.columns+c;
+            for (int a=grid.cellStart[cell]; a<grid.cellStart[cell+1]; a++) {
+                int i = grid.cellBodies[a];
+                const Bounds& q = grid.bounds[i];
+                if (q.maxX < box.minX || box.maxX < q.minX || q.maxY < box.minY || box.maxY < q.minY)
+                    continue;
+                float cornerX = q.minX > box.minX ? q.minX : box.minX;
+                float cornerY = q.minY > box.minY ? q.minY : box.minY;
+                if (cellColumn(grid, cornerX) != c || cellRow(grid, cornerY) != r)
+                    continue;
+                found.push_back(i);
+            }
+        }
+}
+
+/*--------------------------------------------------------- BODY STORE ---------------------------------------------------------*/
+
+/* Every body field is its own array indexed by the body's slot, and the arrays grow together as
+   bodies are created. The motion arrays a step streams through (hot) are kept apart from the
+   shape, mass and flags the collision responses read (cold). Destroyed slots go on a free list
+   and are handed out again; a handle carries the slot's generation, so a handle kept past its
+   body's destruction is detected instead of silently pointing at the next body in that slot. */
+
+struct BodyHandle {
+    int index;
+    int generation;
+};
+
+struct BodyStore {
+    /* hot : position and motion */
+    std::vector<glm::vec3> trans;
+    std::vector<float> rotat;
+    std::vector<float> velx, vely;
+    std::vector<float> Timer;
+    std::vector<float> startX, startY;
+    std::vector<float> currentX, currentY;
+    std::vector<glm::vec3> prevTrans;  // position before the last fixed step
+    std::vector<glm::vec3> stepTrans;  // position after the last fixed step
+
+    /* cold : shape, mass and flags */
+    std::vector< std::vector<CollisionCircle> > centre;
+    std::vector<WorldCircles> world;
+    std::vector<float> Mass;
+    std::vector<char> movable;
+    std::vector<char> solid;       // swept against, so a fast body stops at it instead of stepping through
+    std::vector<int> count;
+
+    std::vector<int> generation;   // bumped when the slot's body is destroyed
+    std::vector<char> alive;
+    std::vector<int> freeList;
+};
+
+int bodyCount(const BodyStore& store)
+{
+    return store.trans.size();
+}
+
+/* New body at rest at the origin, with no circles and zero mass */
+BodyHandle createBody(BodyStore& store)
+{
+    BodyHandle body;
+    if (!store.freeList.empty()) {
+        body.index = store.freeList.back();
+        store.freeList.pop_back();
+    }
+    else {
+        body.index = bodyCount(store);
+        int n = body.index+1;
+        store.trans.resize(n);
+        store.rotat.resize(n);
+        store.velx.resize(n);
+        store.vely.resize(n);
+        store.Timer.resize(n);
+        store.startX.resize(n);
+        store.startY.resize(n);
+        store.currentX.resize(n);
+        store.currentY.resize(n);
+        store.prevTrans.resize(n);
+        store.stepTrans.resize(n);
+        store.centre.resize(n);
+        store.world.resize(n);
+        store.Mass.resize(n);
+        store.movable.resize(n);
+        store.solid.resize(n);
+        store.count.resize(n);
+        store.generation.resize(n);
+        store.alive.resize(n);
+    }
+    int i = body.index;
+    store.trans[i] = store.prevTrans[i] = store.stepTrans[i] = glm::vec3(0.0f, 0.0f, 0.0f);
+    store.rotat[i] = store.velx[i] = store.vely[i] = store.Timer[i] = 0.0f;
+    store.startX[i] = store.startY[i] = store.currentX[i] = store.currentY[i] = 0.0f;
+    store.centre[i].clear();
+    store.world[i].valid = false;
+    store.Mass[i] = 0.0f;
+    store.movable[i] = false;
+    store.solid[i] = false;
+    store.count[i] = 0;
+    store.alive[i] = true;
+    body.generation = store.generation[i];
+    return body;
+}
+
+/* Slot of a live body, or -1 for a handle whose body was destroyed */
+int bodyIndex(const BodyStore& store, BodyHandle body)
+{
+    if (body.index < 0 || body.index >= bodyCount(store))
+        return -1;
+    if (!store.alive[body.index] || store.generation[body.index] != body.generation)
+        return -1;
+    return body.index;
+}
+
+void destroyBody(BodyStore& store, BodyHandle body)
+{
+    int i = bodyIndex(store, body);
+    if (i < 0)
+        return;
+    store.alive[i] = false;
+    store.generation[i]++;
+    store.centre[i].clear(); // No circles, so the broadphase skips the slot
+    store.velx[i] = store.vely[i] = 0.0f;
+    store.freeList.push_back(i);
+}
+
+/* Broadphase over every slot of the store */
+void buildBroadphase(BroadphaseGrid& grid, BodyStore& store, float margin)
+{
+    int n = bodyCount(store);
+    if (n == 0) {
+        grid.pairs.clear();
+        grid.pairStart.assign(1, 0);
+        return;
+    }
+    buildBroadphase(grid, n, &store.trans[0], &store.rotat[0], &store.centre[0], &store.world[0], margin);
+}
+
+/*-------------------------------------------------------- FIXED TIMESTEP --------------------------------------------------------*/
+
+/* The simulation advances in steps of 1/rate seconds of simulated time, however long a frame
+   takes. Wall-clock time since the last frame, scaled by timeScale, goes into an accumulator
+   and every whole step in it is run; what is left over is alpha, the fraction of the next step
+   already elapsed, which the renderer uses to blend between the two latest states. A frame that
+   is too slow runs at most maxSteps steps (more when sped up) and drops the rest, so the
+   simulation slows down instead of spiralling. The same inputs give the same steps whatever the frame rate. */
+
+struct FixedStep {
+    float rate;          // steps per simulated second
+    float timeScale;     // simulated seconds per real second
+    int maxSteps;        // cap on steps in one frame, per unit of timeScale
+    double lastTime;     // negative before the first frame
+    double accumulator;  // simulated seconds not yet stepped
+    float alpha;         // fraction of a step left in the accumulator
+};
+
+/* Number of steps to run this frame, given the current time in seconds */
+int stepsDue(FixedStep& clock, double now)
+{
+    double dt = 1.0/clock.rate;
+    if (clock.lastTime < 0) {
+        clock.lastTime = now;
+        clock.accumulator = dt; // One step on the first frame, so there is a state to draw
+    }
+    else {
+        clock.accumulator += (now-clock.lastTime)*clock.timeScale;
+        clock.lastTime = now;
+    }
+    int steps = (int)(clock.accumulator/dt + 1e-6);
+    int cap = clock.maxSteps*(clock.timeScale > 1 ? (int)ceil(clock.timeScale) : 1);
+    if (steps > cap) {
+        steps = cap;
+        clock.accumulator = steps*dt;
+    }
+    clock.accumulator -= steps*dt;
+    clock.alpha = clock.accumulator > 0 ? (float)(clock.accumulator/dt) : 0.0f;
+    return steps;
+}
+
+void beginStep(BodyStore& store)
+{
+    store.prevTrans = store.trans;
+}
+
+void endStep(BodyStore& store)
+{
+    store.stepTrans = store.trans;
+}
+
+/* Where to draw body i, alpha of the way from its previous to its latest step. A body moved
+   outside a step (placed by input or snapped by a response) is drawn where it is. */
+glm::vec3 renderPosition(const BodyStore& store, int i, float alpha)
+{
+    if (store.trans[i] != store.stepTrans[i])
+        return store.trans[i];
+    return store.prevTrans[i] + (store.trans[i]-store.prevTrans[i])*alpha;
+}
+
+#endif
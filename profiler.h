@@ -0,0 +1,158 @@
+/* Per-pass CPU and GPU timing shared by the GLFW and GLUT builds */
+/* Include after the GL loader (glad / GLEW) */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdio>
+
+#define PROFILE_MAX_PASSES 8
+#define PROFILE_FRAMES 120  // frames of history kept
+
+/* A frame is cut into named passes. Every pass records the CPU time spent between its
+   beginPass() and endPass() calls in the frame, and passes that issue GL work also wrap it in a
+   GL_TIME_ELAPSED query. Each pass owns two queries and alternates them frame to frame, so a
+   query is read back two frames after it was issued, when the GPU is normally done with it. A
+   result that is still not available is left out instead of stalling. Passes must not overlap,
+   since only one time query can be active at a time. History lives in a ring of PROFILE_FRAMES
+   frames, with -1 marking a time that was not measured. */
+
+struct ProfilePass {
+    const char* name;
+    bool gpu;                     // wrapped in time queries
+    double cpu[PROFILE_FRAMES];   // milliseconds, per frame of the ring
+    double gpuTime[PROFILE_FRAMES];
+    GLuint queries[2];
+    int queryFrame[2];            // ring frame each query measures, -1 when idle
+    double started;
+};
+
+struct Profiler {
+    ProfilePass passes[PROFILE_MAX_PASSES];
+    int numPasses;
+    int frame;       // frames profiled so far
+    bool overlay;    // draw the bar graph
+} profiler = {{}, 0, 0, false};
+
+double profileNow()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Register a pass, returning its id. gpu passes get time queries, so call with a current context. */
+int profilePass(const char* name, bool gpu)
+{
+    ProfilePass& pass = profiler.passes[profiler.numPasses];
+    pass.name = name;
+    pass.gpu = gpu;
+    for (int f = 0; f < PROFILE_FRAMES; f++)
+        pass.cpu[f] = pass.gpuTime[f] = -1;
+    pass.queryFrame[0] = pass.queryFrame[1] = -1;
+    if (gpu)
+        glGenQueries(2, pass.queries);
+    return profiler.numPasses++;
+}
+
+/* Ring slot of the frame being profiled */
+int profileSlot()
+{
+    return profiler.frame % PROFILE_FRAMES;
+}
+
+/* Store a finished query's result, if it has one */
+void collectQuery(ProfilePass& pass, int q, bool wait)
+{
+    if (pass.queryFrame[q] < 0)
+        return;
+    GLint available = 0;
+    if (!wait)
+        glGetQueryObjectiv(pass.queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (wait || available) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(pass.queries[q], GL_QUERY_RESULT, &nanoseconds);
+        pass.gpuTime[pass.queryFrame[q]] = nanoseconds/1.0e6;
+    }
+    pass.queryFrame[q] = -1;
+}
+
+void beginProfileFrame()
+{
+    int slot = profileSlot();
+    for (int p = 0; p < profiler.numPasses; p++) {
+        ProfilePass& pass = profiler.passes[p];
+        pass.cpu[slot] = pass.gpuTime[slot] = -1;
+        if (pass.gpu)
+            collectQuery(pass, profiler.frame & 1, false);  // from two frames ago
+    }
+}
+
+void beginPass(int id)
+{
+    ProfilePass& pass = profiler.passes[id];
+    if (pass.gpu)
+        glBeginQuery(GL_TIME_ELAPSED, pass.queries[profiler.frame & 1]);
+    pass.started = profileNow();
+}
+
+/* A pass may run several times in a frame (one per physics step), its times add up */
+void endPass(int id)
+{
+    ProfilePass& pass = profiler.passes[id];
+    int slot = profileSlot();
+    double elapsed = profileNow()-pass.started;
+    pass.cpu[slot] = pass.cpu[slot] < 0 ? elapsed : pass.cpu[slot]+elapsed;
+    if (pass.gpu) {
+        glEndQuery(GL_TIME_ELAPSED);
+        pass.queryFrame[profiler.frame & 1] = slot;
+    }
+}
+
+void endProfileFrame()
+{
+    profiler.frame++;
+}
+
+/* Collect every outstanding query, waiting for the GPU */
+void finishProfile()
+{
+    for (int p = 0; p < profiler.numPasses; p++)
+        if (profiler.passes[p].gpu)
+            for (int q = 0; q < 2; q++)
+                collectQuery(profiler.passes[p], q, true);
+}
+
+/* The frames in the ring as CSV, oldest first : frame, then CPU and GPU milliseconds of each pass */
+bool dumpProfile(const char* path)
+{
+    finishProfile();
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Profiler: cannot write %s\n", path);
+        return false;
+    }
+    fprintf(file, "frame");
+    for (int p = 0; p < profiler.numPasses; p++)
+        fprintf(file, ",%s_cpu_ms,%s_gpu_ms", profiler.passes[p].name, profiler.passes[p].name);
+    fprintf(file, "\n");
+    int first = profiler.frame > PROFILE_FRAMES ? profiler.frame-PROFILE_FRAMES : 0;
+    for (int f = first; f < profiler.frame; f++) {
+        fprintf(file, "%d", f);
+        for (int p = 0; p < profiler.numPasses; p++) {
+            const ProfilePass& pass = profiler.passes[p];
+            double cpu = pass.cpu[f % PROFILE_FRAMES], gpu = pass.gpuTime[f % PROFILE_FRAMES];
+            if (cpu >= 0)
+                fprintf(file, ",%.4f", cpu);
+            else
+                fprintf(file, ",");
+            if (gpu >= 0)
+                fprintf(file, ",%.4f", gpu);
+            else
+                fprintf(file, ",");
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+    return true;
+}
+
+#endif
@@ -0,0 +1,654 @@
+/* Rendering helpers shared by the GLFW and GLUT builds */
+/* Include after the GL loader (glad / GLEW) and glm */
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "physics.h" // formatAngle, D2R
+#include "trace.h"
+
+struct VAO {
+    GLuint VertexArrayID;
+    GLuint VertexBuffer;
+    GLuint ColorBuffer;     // 0 for interleaved meshes, whose colours live in VertexBuffer
+    GLuint ElementBuffer;   // 0 when not indexed
+    GLuint InstanceBuffer;
+
+    GLenum PrimitiveMode;
+    GLenum FillMode;
+    int NumVertices;
+    int NumIndices;         // 0 when not indexed
+    int BaseVertex;         // first vertex in the geometry pool (0 for meshes with their own buffers)
+    int FirstIndex;         // first index in the geometry pool
+    int NumInstances;
+    std::vector<GLfloat> Instances; // CPU copy of the instance data, used by the render queue
+
+    VAO() {}
+    ~VAO(); // Deletes the GL objects this mesh owns
+private:
+    VAO(const VAO&); // Owns GL handles - not copyable
+    VAO& operator=(const VAO&);
+};
+typedef struct VAO VAO;
+
+/* Interleaved vertex : position and RGBA8 colour in 16 bytes, against 24 in two float VBOs */
+struct Vertex {
+    GLfloat x, y, z;
+    GLubyte r, g, b, a;
+};
+
+struct GLMatrices {
+    glm::mat4 model;
+    GLuint MatrixID; // "Model" uniform
+} Matrices;
+
+/*--------------------------------------------------------- CAMERA ---------------------------------------------------------*/
+
+/* The camera owns projection, view and their product. Setters only mark it dirty when a value
+   actually changes, VP is rebuilt on first use after that, and the shaders read VP from a
+   uniform buffer that is re-uploaded at most once per frame. */
+
+#define CAMERA_BINDING 0 // uniform buffer binding point of the "Camera" block
+
+struct Camera {
+    float ortho[6];             // left, right, bottom, top, near, far
+    glm::vec3 eye, target, up;
+    glm::mat4 projection, view, VP;
+    bool dirty;                 // VP must be rebuilt
+    bool stale;                 // uniform buffer must be re-uploaded
+    GLuint UniformBuffer;
+} camera = { {-1,1,-1,1,0.1f,500.0f}, glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0),
+             glm::mat4(1.0f), glm::mat4(1.0f), glm::mat4(1.0f), true, true, 0 };
+
+void setOrtho(float left,float right,float bottom,float top,float near,float far)
+{
+    float bounds[]={left,right,bottom,top,near,far};
+    for(int i=0;i<6;i++)
+    {
+        if(camera.ortho[i]!=bounds[i])
+        {
+            camera.ortho[i]=bounds[i];
+            camera.dirty=true;
+        }
+    }
+}
+
+void setLookAt(glm::vec3 eye,glm::vec3 target,glm::vec3 up)
+{
+    if(eye==camera.eye && target==camera.target && up==camera.up)
+        return;
+    camera.eye=eye;
+    camera.target=target;
+    camera.up=up;
+    camera.dirty=true;
+}
+
+/* Cached projection * view, rebuilt only after a setter changed something */
+const glm::mat4& cameraVP()
+{
+    if(camera.dirty)
+    {
+        float* o=camera.ortho;
+        camera.projection = glm::ortho(o[0], o[1], o[2], o[3], o[4], o[5]);
+        camera.view = glm::lookAt(camera.eye, camera.target, camera.up);
+        camera.VP = camera.projection * camera.view;
+        camera.dirty = false;
+        camera.stale = true;
+    }
+    return camera.VP;
+}
+
+/* Point a program's "Camera" block at the shared uniform buffer */
+void bindCameraBlock(GLuint program)
+{
+    GLuint block = glGetUniformBlockIndex(program, "Camera");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, block, CAMERA_BINDING);
+}
+
+/* Send VP to the GPU if it changed since the last upload */
+void uploadCamera()
+{
+    const glm::mat4& VP = cameraVP();
+    if (camera.UniformBuffer == 0) {
+        glGenBuffers (1, &camera.UniformBuffer);
+        glBindBuffer (GL_UNIFORM_BUFFER, camera.UniformBuffer);
+        glBufferData (GL_UNIFORM_BUFFER, sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase (GL_UNIFORM_BUFFER, CAMERA_BINDING, camera.UniformBuffer);
+        camera.stale = true;
+    }
+    if (!camera.stale)
+        return;
+    glBindBuffer (GL_UNIFORM_BUFFER, camera.UniformBuffer);
+    glBufferSubData (GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), &VP[0][0]);
+    camera.stale = false;
+}
+
+/* Generate VAO, VBOs and return VAO handle */
+struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
+{
+    TRACE_SCOPE("create3DObject");
+    struct VAO* vao = new struct VAO;
+    vao->PrimitiveMode = primitive_mode;
+    vao->NumVertices = numVertices;
+    vao->FillMode = fill_mode;
+    vao->ElementBuffer = 0;
+    vao->NumIndices = 0;
+    vao->BaseVertex = 0;
+    vao->FirstIndex = 0;
+    vao->InstanceBuffer = 0;
+    vao->NumInstances = 0;
+
+    // Create Vertex Array Object
+    // Should be done after CreateWindow and before any other GL calls
+    glGenVertexArrays(1, &(vao->VertexArrayID)); // VAO
+    glGenBuffers (1, &(vao->VertexBuffer)); // VBO - vertices
+    glGenBuffers (1, &(vao->ColorBuffer));  // VBO - colors
+
+    glBindVertexArray (vao->VertexArrayID); // Bind the VAO
+    glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer); // Bind the VBO vertices
+    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), vertex_buffer_data, GL_STATIC_DRAW); // Copy the vertices into VBO
+    glVertexAttribPointer(
+            0,                  // attribute 0. Vertices
+            3,                  // size (x,y,z)
+            GL_FLOAT,           // type
+            GL_FALSE,           // normalized?
+            0,                  // stride
+            (void*)0            // array buffer offset
+            );
+    glEnableVertexAttribArray(0);
+
+    glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer); // Bind the VBO colors
+    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), color_buffer_data, GL_STATIC_DRAW);  // Copy the vertex colors
+    glVertexAttribPointer(
+            1,                  // attribute 1. Color
+            3,                  // size (r,g,b)
+            GL_FLOAT,           // type
+            GL_FALSE,           // normalized?
+            0,                  // stride
+            (void*)0            // array buffer offset
+            );
+    glEnableVertexAttribArray(1);
+
+    return vao;
+}
+
+/* Generate VAO, VBOs and return VAO handle - Common Color for all vertices */
+struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat red, const GLfloat green, const GLfloat blue, GLenum fill_mode=GL_FILL)
+{
+    std::vector<GLfloat> color_buffer_data (3*numVertices); // Copied into the VBO, freed on return
+    for (int i=0; i<numVertices; i++) {
+        color_buffer_data [3*i] = red;
+        color_buffer_data [3*i + 1] = green;
+        color_buffer_data [3*i + 2] = blue;
+    }
+
+    return create3DObject(primitive_mode, numVertices, vertex_buffer_data, &color_buffer_data[0], fill_mode);
+}
+
+/* Pack float positions (x,y,z) and colours (r,g,b) into interleaved vertices */
+std::vector<Vertex> packVertices (int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data)
+{
+    std::vector<Vertex> vertices(numVertices);
+    for (int i=0; i<numVertices; i++) {
+        Vertex& v = vertices[i];
+        v.x = vertex_buffer_data[3*i];
+        v.y = vertex_buffer_data[3*i + 1];
+        v.z = vertex_buffer_data[3*i + 2];
+        v.r = (GLubyte)(color_buffer_data[3*i] * 255.0f + 0.5f);
+        v.g = (GLubyte)(color_buffer_data[3*i + 1] * 255.0f + 0.5f);
+        v.b = (GLubyte)(color_buffer_data[3*i + 2] * 255.0f + 0.5f);
+        v.a = 255;
+    }
+    return vertices;
+}
+
+/* Generate VAO with one interleaved VBO and an optional index buffer (index_data may be NULL) */
+struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const Vertex* vertex_data, int numIndices, const GLushort* index_data, GLenum fill_mode=GL_FILL)
+{
+    TRACE_SCOPE("create3DObject");
+    struct VAO* vao = new struct VAO;
+    vao->PrimitiveMode = primitive_mode;
+    vao->NumVertices = numVertices;
+    vao->NumIndices = index_data ? numIndices : 0;
+    vao->FillMode = fill_mode;
+    vao->ColorBuffer = 0;
+    vao->ElementBuffer = 0;
+    vao->BaseVertex = 0;
+    vao->FirstIndex = 0;
+    vao->InstanceBuffer = 0;
+    vao->NumInstances = 0;
+
+    glGenVertexArrays(1, &(vao->VertexArrayID)); // VAO
+    glGenBuffers (1, &(vao->VertexBuffer)); // VBO - vertices and colors
+
+    glBindVertexArray (vao->VertexArrayID); // Bind the VAO
+    glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer);
+    glBufferData (GL_ARRAY_BUFFER, numVertices*sizeof(Vertex), vertex_data, GL_STATIC_DRAW);
+    glVertexAttribPointer(
+            0,                  // attribute 0. Vertices
+            3,                  // size (x,y,z)
+            GL_FLOAT,           // type
+            GL_FALSE,           // normalized?
+            sizeof(Vertex),     // stride
+            (void*)0            // array buffer offset
+            );
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(
+            1,                  // attribute 1. Color
+            4,                  // size (r,g,b,a)
+            GL_UNSIGNED_BYTE,   // type
+            GL_TRUE,            // normalized? 0..255 -> 0..1
+            sizeof(Vertex),     // stride
+            (void*)(3*sizeof(GLfloat)) // array buffer offset
+            );
+    glEnableVertexAttribArray(1);
+
+    if (vao->NumIndices > 0) {
+        glGenBuffers (1, &(vao->ElementBuffer)); // EBO - indices, recorded in the VAO
+        glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, vao->ElementBuffer);
+        glBufferData (GL_ELEMENT_ARRAY_BUFFER, numIndices*sizeof(GLushort), index_data, GL_STATIC_DRAW);
+    }
+
+    return vao;
+}
+
+/*--------------------------------------------------------- GEOMETRY POOL ---------------------------------------------------------*/
+
+/* Static meshes are sub-allocated out of one shared VAO holding one vertex buffer and one index
+   buffer. A pooled VAO handle only records where its vertices (BaseVertex) and indices (FirstIndex)
+   start; indices stay relative to the mesh, so 16 bit indices work however large the pool grows.
+   The buffers double when full, so startup creates the same three GL objects for any level. */
+
+struct GeometryPool {
+    GLuint VertexArrayID;
+    GLuint VertexBuffer;
+    GLuint ElementBuffer;
+    int vertexCount, vertexCapacity;
+    int indexCount, indexCapacity;
+} geometryPool = {0, 0, 0, 0, 1024, 0, 2048};
+
+// Copy a pool buffer into a new one of newBytes and free the old one
+GLuint growPoolBuffer (GLuint buffer, int usedBytes, int newBytes)
+{
+    GLuint grown;
+    glGenBuffers (1, &grown);
+    glBindBuffer (GL_COPY_WRITE_BUFFER, grown);
+    glBufferData (GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+    if (usedBytes > 0) {
+        glBindBuffer (GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData (GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+    }
+    glDeleteBuffers (1, &buffer);
+    return grown;
+}
+
+// Make room for numVertices more vertices and numIndices more indices
+void reservePool (int numVertices, int numIndices)
+{
+    GeometryPool& pool = geometryPool;
+    bool created = (pool.VertexArrayID == 0);
+    if (created)
+        glGenVertexArrays(1, &pool.VertexArrayID);
+    glBindVertexArray (pool.VertexArrayID);
+
+    if (created || pool.vertexCount + numVertices > pool.vertexCapacity) {
+        while (pool.vertexCount + numVertices > pool.vertexCapacity)
+            pool.vertexCapacity *= 2;
+        pool.VertexBuffer = growPoolBuffer(pool.VertexBuffer, pool.vertexCount*sizeof(Vertex), pool.vertexCapacity*sizeof(Vertex));
+        // Attribute pointers capture the buffer, so point them at the new one
+        glBindBuffer (GL_ARRAY_BUFFER, pool.VertexBuffer);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)(3*sizeof(GLfloat)));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+    }
+    if (created || pool.indexCount + numIndices > pool.indexCapacity) {
+        while (pool.indexCount + numIndices > pool.indexCapacity)
+            pool.indexCapacity *= 2;
+        pool.ElementBuffer = growPoolBuffer(pool.ElementBuffer, pool.indexCount*sizeof(GLushort), pool.indexCapacity*sizeof(GLushort));
+        glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, pool.ElementBuffer); // Recorded in the pool VAO
+    }
+}
+
+/* Sub-allocate a static mesh from the geometry pool and return its VAO handle (index_data may be NULL) */
+struct VAO* createPooledObject (GLenum primitive_mode, int numVertices, const Vertex* vertex_data, int numIndices, const GLushort* index_data, GLenum fill_mode=GL_FILL)
+{
+    TRACE_SCOPE("createPooledObject");
+    if (!index_data)
+        numIndices = 0;
+    reservePool(numVertices, numIndices);
+    GeometryPool& pool = geometryPool;
+
+    struct VAO* vao = new struct VAO;
+    vao->PrimitiveMode = primitive_mode;
+    vao->FillMode = fill_mode;
+    vao->VertexArrayID = pool.VertexArrayID;
+    vao->VertexBuffer = 0;  // The buffers belong to the pool
+    vao->ColorBuffer = 0;
+    vao->ElementBuffer = 0;
+    vao->NumVertices = numVertices;
+    vao->NumIndices = numIndices;
+    vao->BaseVertex = pool.vertexCount;
+    vao->FirstIndex = pool.indexCount;
+    vao->InstanceBuffer = 0;
+    vao->NumInstances = 0;
+
+    glBindBuffer (GL_ARRAY_BUFFER, pool.VertexBuffer);
+    glBufferSubData (GL_ARRAY_BUFFER, pool.vertexCount*sizeof(Vertex), numVertices*sizeof(Vertex), vertex_data);
+    pool.vertexCount += numVertices;
+    if (numIndices > 0) {
+        glBufferSubData (GL_ELEMENT_ARRAY_BUFFER, pool.indexCount*sizeof(GLushort), numIndices*sizeof(GLushort), index_data);
+        pool.indexCount += numIndices;
+    }
+    return vao;
+}
+
+/* Pooled meshes leave their vertices in the pool; everything else is owned and deleted here */
+VAO::~VAO()
+{
+    GLuint buffers[] = {VertexBuffer, ColorBuffer, ElementBuffer, InstanceBuffer};
+    glDeleteBuffers (4, buffers); // Zero names are ignored
+    if (VertexArrayID != geometryPool.VertexArrayID)
+        glDeleteVertexArrays (1, &VertexArrayID);
+}
+
+/* Issue the draw call for a bound VAO - instances is 0 for a plain draw */
+void drawVAO (struct VAO* vao, int instances)
+{
+    if (vao->NumIndices > 0) {
+        void* indices = (void*)(vao->FirstIndex*sizeof(GLushort));
+        if (instances > 0)
+            glDrawElementsInstancedBaseVertex(vao->PrimitiveMode, vao->NumIndices, GL_UNSIGNED_SHORT, indices, instances, vao->BaseVertex);
+        else
+            glDrawElementsBaseVertex(vao->PrimitiveMode, vao->NumIndices, GL_UNSIGNED_SHORT, indices, vao->BaseVertex);
+    }
+    else if (instances > 0)
+        glDrawArraysInstanced(vao->PrimitiveMode, vao->BaseVertex, vao->NumVertices, instances); // Every copy in one call
+    else
+        glDrawArrays(vao->PrimitiveMode, vao->BaseVertex, vao->NumVertices); // Starting from the mesh's first vertex
+}
+
+/* Render the VBOs handled by VAO */
+void draw3DObject (struct VAO* vao)
+{
+    // Change the Fill Mode for this object
+    glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
+
+    // Bind the VAO to use
+    glBindVertexArray (vao->VertexArrayID);
+
+    // Enable Vertex Attribute 0 - 3d Vertices
+    glEnableVertexAttribArray(0);
+    // Bind the VBO to use
+    glBindBuffer(GL_ARRAY_BUFFER, vao->VertexBuffer);
+
+    // Enable Vertex Attribute 1 - Color
+    glEnableVertexAttribArray(1);
+    // Bind the VBO to use
+    glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
+
+    // The render queue may have pointed the instance attributes elsewhere
+    glDisableVertexAttribArray(3);
+    if (vao->NumInstances > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, vao->InstanceBuffer);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    }
+    else
+        glDisableVertexAttribArray(2);
+
+    // Draw the geometry ! Indexed meshes go through their element buffer
+    drawVAO(vao, vao->NumInstances);
+}
+
+/* Attach per-instance data to a VAO - draw3DObject then renders all copies in one call */
+/* instance_data holds numInstances (rotation in radians, x offset, y offset) triples */
+void setInstances (struct VAO* vao, int numInstances, const GLfloat* instance_data)
+{
+    vao->NumInstances = numInstances;
+    vao->Instances.assign(instance_data, instance_data + 3*numInstances);
+    if (vao->InstanceBuffer == 0)
+        glGenBuffers (1, &(vao->InstanceBuffer)); // VBO - per-instance data
+
+    glBindVertexArray (vao->VertexArrayID);
+    glBindBuffer (GL_ARRAY_BUFFER, vao->InstanceBuffer);
+    glBufferData (GL_ARRAY_BUFFER, 3*numInstances*sizeof(GLfloat), instance_data, GL_STATIC_DRAW);
+    glVertexAttribPointer(
+            2,                  // attribute 2. Instance data
+            3,                  // size (angle,x,y)
+            GL_FLOAT,           // type
+            GL_FALSE,           // normalized?
+            0,                  // stride
+            (void*)0            // array buffer offset
+            );
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1); // Advance once per instance, not per vertex
+}
+
+// Rotated copies of a sector from angle A1 to A2 (degrees, inclusive) every step degrees
+void setSectorInstances(VAO* sector,float A1,float A2,float step)
+{
+    int copies=(int)((A2-A1)/step+0.5f)+1;
+    std::vector<GLfloat> instance_data(3*copies,0.0f);
+    for(int k=0;k<copies;k++)
+    {
+        instance_data[3*k]=D2R(formatAngle(A1+k*step));
+    }
+    setInstances(sector,copies,&instance_data[0]);
+}
+
+/*--------------------------------------------------------- MESH CACHE ---------------------------------------------------------*/
+
+/* The create*() helpers look a mesh up by shape, parameters and colours before building it, so
+   asking for the same mesh again - even every frame - hands back the existing VAO instead of
+   allocating new GL objects. The cache owns the meshes; clearMeshCache() deletes them. */
+
+std::map<std::string, VAO*> meshCache;
+
+// Exact key : floats are printed in hex so equal parameters always give equal keys
+std::string meshKey(const char* shape,const float* params,int numParams,const GLfloat* colours=NULL,int numColours=0)
+{
+    std::string key(shape);
+    char number[32];
+    for(int i=0;i<numParams;i++)
+    {
+        snprintf(number,sizeof(number)," %a",params[i]);
+        key+=number;
+    }
+    key+=" /";
+    for(int i=0;i<numColours;i++)
+    {
+        snprintf(number,sizeof(number)," %a",colours[i]);
+        key+=number;
+    }
+    return key;
+}
+
+VAO* findMesh(const std::string& key)
+{
+    std::map<std::string, VAO*>::iterator it=meshCache.find(key);
+    return it==meshCache.end() ? NULL : it->second;
+}
+
+VAO* cacheMesh(const std::string& key,VAO* vao)
+{
+    meshCache[key]=vao;
+    return vao;
+}
+
+// Needs the GL context, so call it before the window is destroyed
+void clearMeshCache()
+{
+    for(std::map<std::string, VAO*>::iterator it=meshCache.begin();it!=meshCache.end();++it)
+        delete it->second;
+    meshCache.clear();
+}
+
+/*--------------------------------------------------------- RENDER QUEUE ---------------------------------------------------------*/
+
+/* drawobject()/trt() only record what to draw; flushRenderQueue() at the end of the frame
+   sorts the submissions by fill mode, primitive and VAO and draws every run of the same VAO
+   with one instanced call. Each submission gets its own depth layer in submission order, so the
+   depth test still resolves overlaps as if everything had been drawn in order. */
+
+struct RenderItem {
+    VAO* vao;
+    float angle, x, y, z;   // 2D placement (rotation in radians about the z axis)
+    int layer;              // submission order within the frame
+    bool custom;            // placement that is not a z rotation - drawn on its own with model
+    glm::mat4 model;
+};
+
+std::vector<RenderItem> renderQueue;
+std::vector<GLfloat> renderInstances; // (angle,x,y,depth) per instance, rebuilt every flush
+GLuint renderInstanceBuffer = 0;
+int renderDrawCalls = 0; // draw calls issued by the last flush
+
+void queueObject(VAO* vao,float x,float y,float z,float angle)
+{
+    RenderItem item;
+    item.vao=vao;
+    item.angle=angle;
+    item.x=x;
+    item.y=y;
+    item.z=z;
+    item.layer=renderQueue.size();
+    item.custom=false;
+    renderQueue.push_back(item);
+}
+
+void queueObject(VAO* vao,glm::mat4 model)
+{
+    queueObject(vao,0.0f,0.0f,0.0f,0.0f);
+    renderQueue.back().custom=true;
+    renderQueue.back().model=model;
+}
+
+// qsort order : fill mode, primitive, VAO, mesh, batched before custom, then submission order
+int compareRenderItems(const void* p,const void* q)
+{
+    const RenderItem& a=*(const RenderItem*)p;
+    const RenderItem& b=*(const RenderItem*)q;
+    if(a.vao->FillMode!=b.vao->FillMode)
+        return a.vao->FillMode<b.vao->FillMode ? -1 : 1;
+    if(a.vao->PrimitiveMode!=b.vao->PrimitiveMode)
+        return a.vao->PrimitiveMode<b.vao->PrimitiveMode ? -1 : 1;
+    if(a.vao->VertexArrayID!=b.vao->VertexArrayID)
+        return a.vao->VertexArrayID<b.vao->VertexArrayID ? -1 : 1;
+    if(a.vao->BaseVertex!=b.vao->BaseVertex) // Pooled meshes share one VAO
+        return a.vao->BaseVertex-b.vao->BaseVertex;
+    if(a.vao!=b.vao)
+        return a.vao<b.vao ? -1 : 1;
+    if(a.custom!=b.custom)
+        return a.custom ? 1 : -1;
+    return a.layer-b.layer;
+}
+
+// Append the instances of one submission, composing it with the VAO's own copies
+void appendInstances(const RenderItem& item,float depth)
+{
+    VAO* vao=item.vao;
+    if(vao->NumInstances==0)
+    {
+        GLfloat data[]={item.angle,item.x,item.y,depth};
+        renderInstances.insert(renderInstances.end(),data,data+4);
+        return;
+    }
+    float c=cos(item.angle),s=sin(item.angle);
+    for(int k=0;k<vao->NumInstances;k++)
+    {
+        const GLfloat* own=&vao->Instances[3*k];
+        GLfloat data[]={item.angle+own[0],item.x+c*own[1]-s*own[2],item.y+s*own[1]+c*own[2],depth};
+        renderInstances.insert(renderInstances.end(),data,data+4);
+    }
+}
+
+/* Draw everything queued this frame with the current program, then empty the queue */
+void flushRenderQueue()
+{
+    renderDrawCalls=0;
+    if(renderQueue.empty())
+        return;
+
+    uploadCamera();
+    glm::mat4 identity = glm::mat4(1.0f);
+    float layerStep = 2.0f/renderQueue.size(); // Layers stay between z and z+2, in front of the far plane
+
+    qsort(&renderQueue[0],renderQueue.size(),sizeof(RenderItem),compareRenderItems);
+
+    // Gather the instances of every batched run into one buffer
+    // A run is consecutive submissions of one VAO, recorded at its first item
+    renderInstances.clear();
+    std::vector<int> runLength(renderQueue.size(),0);
+    int head=-1;
+    for(int i=0;i<(int)renderQueue.size();i++)
+    {
+        RenderItem& item=renderQueue[i];
+        if(item.custom)
+        {
+            head=-1;
+            continue;
+        }
+        if(head<0 || renderQueue[head].vao!=item.vao)
+            head=i;
+        runLength[head]+=(item.vao->NumInstances>0 ? item.vao->NumInstances : 1);
+        appendInstances(item,item.z+item.layer*layerStep);
+    }
+    if (renderInstanceBuffer == 0)
+        glGenBuffers (1, &renderInstanceBuffer);
+    glBindBuffer (GL_ARRAY_BUFFER, renderInstanceBuffer);
+    glBufferData (GL_ARRAY_BUFFER, renderInstances.size()*sizeof(GLfloat), NULL, GL_STREAM_DRAW); // Orphan last frame's data
+    if (!renderInstances.empty())
+        glBufferSubData (GL_ARRAY_BUFFER, 0, renderInstances.size()*sizeof(GLfloat), &renderInstances[0]);
+
+    glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &identity[0][0]); // Batched draws carry their model per instance
+    GLenum fillMode = 0;
+    int first = 0; // first instance of the current run in renderInstanceBuffer
+    GLuint boundVAO = 0; // Pooled meshes share a VAO, bind it once for all of them
+    for(int i=0;i<(int)renderQueue.size();i++)
+    {
+        RenderItem& item=renderQueue[i];
+        VAO* vao=item.vao;
+        if (!item.custom && runLength[i]==0)
+            continue; // Already drawn with the head of its run
+        if (vao->FillMode != fillMode) {
+            glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
+            fillMode = vao->FillMode;
+        }
+
+        if (item.custom) {
+            // One draw with its own model matrix, pushed to its depth layer
+            Matrices.model = glm::translate(glm::vec3(0,0,item.layer*layerStep)) * item.model;
+            glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &Matrices.model[0][0]);
+            draw3DObject(vao);
+            boundVAO = vao->VertexArrayID;
+            glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &identity[0][0]);
+            renderDrawCalls++;
+            continue;
+        }
+
+        if (vao->VertexArrayID != boundVAO) {
+            glBindVertexArray (vao->VertexArrayID);
+            boundVAO = vao->VertexArrayID;
+        }
+        glBindBuffer (GL_ARRAY_BUFFER, renderInstanceBuffer);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 4*sizeof(GLfloat), (void*)(first*4*sizeof(GLfloat)));
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 4*sizeof(GLfloat), (void*)((first*4+3)*sizeof(GLfloat)));
+        glEnableVertexAttribArray(2);
+        glEnableVertexAttribArray(3);
+        glVertexAttribDivisor(2, 1);
+        glVertexAttribDivisor(3, 1);
+        drawVAO(vao, runLength[i]);
+        renderDrawCalls++;
+        first += runLength[i];
+    }
+    renderQueue.clear();
+}
+
+#endif
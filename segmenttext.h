@@ -0,0 +1,97 @@
+/* Seven-segment text : a whole string of segment glyphs in one vertex buffer, drawn with one call */
+/* Include after render.h */
+#ifndef SEGMENTTEXT_H
+#define SEGMENTTEXT_H
+
+#include <string>
+#include <vector>
+
+/* A glyph is up to eight line segments in a box of 2*halfWidth by 2*halfHeight centred on its
+   origin, picked by the bits of segmentMask():
+
+        --0--
+       |     |        bit 7 is the diagonal from the centre
+       1     5        to the bottom right, for the r
+       |     |
+        --6--
+       |   \ |
+       2    74
+       |     \|
+        --3--
+
+   setSegmentText() builds the line list for a string into the text's own vertex buffer and
+   keeps it until the string changes, so a HUD whose text rarely changes uploads nothing from
+   frame to frame, and each text is a single item in the render queue however long it is. */
+
+struct SegmentText {
+    std::string text;       // what the buffer holds
+    float halfWidth, halfHeight, advance;  // glyph box and the distance between glyph origins
+    GLubyte r, g, b;
+    VAO* vao;               // NULL until the first setSegmentText()
+};
+
+/* Lit segments of a character, 0 for the ones without a glyph */
+int segmentMask(char c)
+{
+    switch (c) {
+    case '0': case 'o': return 63;
+    case '1': return 48;
+    case '2': return 109;
+    case '3': return 121;
+    case '4': return 114;
+    case '5': case 's': return 91;
+    case '6': return 95;
+    case '7': return 49;
+    case '8': return 127;
+    case '9': return 123;
+    case 'c': return 15;
+    case 'r': return 231;
+    case 'e': return 79;
+    }
+    return 0;
+}
+
+SegmentText segmentText(float halfWidth, float halfHeight, float advance, GLubyte r, GLubyte g, GLubyte b)
+{
+    SegmentText text = {"", halfWidth, halfHeight, advance, r, g, b, NULL};
+    return text;
+}
+
+/* Rebuild the buffer if text differs from what it holds */
+void setSegmentText(SegmentText& shown, const std::string& text)
+{
+    if (shown.vao && text == shown.text)
+        return;
+    shown.text = text;
+    float w = shown.halfWidth, h = shown.halfHeight;
+    // Segment ends in the glyph box, in bit order
+    const float ends[8][4] = {
+        {-w,  h,  w,  h}, {-w,  h, -w,  0}, {-w,  0, -w, -h}, {-w, -h,  w, -h},
+        { w, -h,  w,  0}, { w,  0,  w,  h}, {-w,  0,  w,  0}, { 0,  0,  w, -h},
+    };
+    std::vector<Vertex> vertices;
+    for (size_t i = 0; i < text.size(); i++) {
+        int mask = segmentMask(text[i]);
+        for (int s = 0; s < 8; s++) {
+            if (!((mask >> s) & 1))
+                continue;
+            for (int end = 0; end < 2; end++) {
+                Vertex v = {i*shown.advance + ends[s][2*end], ends[s][2*end+1], 0.0f, shown.r, shown.g, shown.b, 255};
+                vertices.push_back(v);
+            }
+        }
+    }
+    int numVertices = vertices.size();
+    if (vertices.empty())
+        vertices.push_back(Vertex());  // keeps the buffer valid, nothing is drawn from it
+    if (!shown.vao) {
+        shown.vao = create3DObject(GL_LINES, vertices.size(), &vertices[0], 0, NULL, GL_LINE);
+    }
+    else {
+        glBindBuffer (GL_ARRAY_BUFFER, shown.vao->VertexBuffer);
+        glBufferData (GL_ARRAY_BUFFER, vertices.size()*sizeof(Vertex), &vertices[0], GL_DYNAMIC_DRAW);
+    }
+    shown.vao->NumVertices = numVertices;
+}
+
+#endif
@@ -0,0 +1,141 @@
+/* Linked shader programs cached on disk as driver binaries, so warm starts skip compiling */
+/* Include after the GL loader (glad / GLEW) */
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+/* Programs are saved with glGetProgramBinary (GL 4.1 / ARB_get_program_binary) under
+   SHADER_CACHE_DIR, one file per program named by a hash of both shader sources and the
+   driver's vendor, renderer and version strings, so editing a shader or changing driver
+   picks a new file. A binary the driver rejects (it may refuse old ones after an update) just
+   misses, and the caller compiles from source and saves again. Drivers without any binary
+   format never touch the disk. */
+
+#define SHADER_CACHE_DIR "shadercache"
+
+struct ShaderCacheHeader {
+    char magic[4];                 // "GLPB"
+    unsigned int format;           // driver's binary format
+    unsigned int length;           // bytes of binary that follow
+    unsigned long long key;
+};
+
+/* FNV-1a, continued from hash */
+unsigned long long cacheHash(unsigned long long hash, const char* data, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+unsigned long long shaderCacheKey(const std::string& vertexCode, const std::string& fragmentCode)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    hash = cacheHash(hash, vertexCode.c_str(), vertexCode.size()+1);  // the terminators separate the fields
+    hash = cacheHash(hash, fragmentCode.c_str(), fragmentCode.size()+1);
+    static const GLenum driver[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (int i = 0; i < 3; i++) {
+        const char* text = (const char*) glGetString(driver[i]);
+        if (text)
+            hash = cacheHash(hash, text, strlen(text)+1);
+    }
+    return hash;
+}
+
+/* True when the driver can hand back at least one kind of program binary */
+bool programBinarySupported()
+{
+    static int formats = -1;
+    if (formats < 0) {
+        formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        while (glGetError() != GL_NO_ERROR)
+            ;  // GL_INVALID_ENUM where the query is unknown, formats stays 0
+    }
+    return formats > 0;
+}
+
+std::string shaderCachePath(unsigned long long key)
+{
+    char name[64];
+    snprintf(name, sizeof(name), SHADER_CACHE_DIR "/%016llx.bin", key);
+    return name;
+}
+
+/* The cached program for key, linked and ready to use, or 0 if there is none or the driver rejects it */
+GLuint loadProgramBinary(unsigned long long key)
+{
+    if (!programBinarySupported())
+        return 0;
+    FILE* file = fopen(shaderCachePath(key).c_str(), "rb");
+    if (!file)
+        return 0;
+    ShaderCacheHeader header;
+    std::vector<char> binary;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+              && !memcmp(header.magic, "GLPB", 4) && header.key == key && header.length > 0;
+    if (ok) {
+        binary.resize(header.length);
+        ok = fread(&binary[0], 1, header.length, file) == header.length;
+    }
+    fclose(file);
+    if (!ok)
+        return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, &binary[0], header.length);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        glDeleteProgram(program);
+        while (glGetError() != GL_NO_ERROR)
+            ;
+        return 0;
+    }
+    return program;
+}
+
+/* Ask for the binary to be kept, call between glCreateProgram and glLinkProgram */
+void prepareProgramBinary(GLuint program)
+{
+    if (programBinarySupported())
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+/* Save a successfully linked program under key */
+bool saveProgramBinary(GLuint program, unsigned long long key)
+{
+    if (!programBinarySupported())
+        return false;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+    ShaderCacheHeader header;
+    memcpy(header.magic, "GLPB", 4);
+    header.key = key;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, NULL, &format, &binary[0]);
+    header.format = format;
+    header.length = length;
+
+    mkdir(SHADER_CACHE_DIR, 0755);
+    FILE* file = fopen(shaderCachePath(key).c_str(), "wb");
+    if (!file) {
+        fprintf(stderr, "Shader cache: cannot write %s\n", shaderCachePath(key).c_str());
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(&binary[0], 1, length, file) == (size_t) length;
+    fclose(file);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,207 @@
+/* Shader programs built together : every compile and link is issued before any result is read */
+/* Include after the GL loader (glad / GLEW), shadersource.h and shadercache.h */
+#ifndef SHADERPROGRAMS_H
+#define SHADERPROGRAMS_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+/* Programs are registered with addShaderProgram() and built by buildShaderPrograms() in three
+   sweeps: load every source and issue the compiles, then issue every link, then read the
+   results. No status is queried until all the work is queued, so drivers that compile on their
+   own threads (KHR/ARB_parallel_shader_compile, asked here for as many threads as they like) work
+   on all programs at once, and startup grows with the slowest program rather than the sum.
+   Programs found in the shader cache skip straight to the end.
+
+   A variant is the same files with extra lines, usually #defines, put after #version, so one
+   shader can be built several ways side by side. */
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+struct ShaderProgram {
+    const char* vertexPath;
+    const char* fragmentPath;
+    const char* defines;         // variant lines after #version, or NULL
+    GLuint* program;             // receives each program that links
+    void (*linked)(GLuint);      // sets up a linked program's uniforms, or NULL
+    GLuint id, vertexShader, fragmentShader;  // build in flight, id 0 when none
+    unsigned long long key;      // shader cache key of the sources being built
+};
+std::vector<ShaderProgram> shaderPrograms;
+
+bool hasGLExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++)
+        if (!strcmp((const char*) glGetStringi(GL_EXTENSIONS, i), name))
+            return true;
+    return false;
+}
+
+/* True when build completion can be polled without blocking, checked once */
+bool parallelShaderCompile()
+{
+    static int parallel = -1;
+    if (parallel < 0) {
+        parallel = hasGLExtension("GL_KHR_parallel_shader_compile") || hasGLExtension("GL_ARB_parallel_shader_compile");
+        if (hasGLExtension("GL_ARB_parallel_shader_compile") && glMaxShaderCompilerThreadsARB)
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);  // as many as the driver wants
+    }
+    return parallel;
+}
+
+void addShaderProgram(GLuint* program, const char* vertexPath, const char* fragmentPath,
+                      void (*linked)(GLuint), const char* defines = NULL)
+{
+    ShaderProgram entry = {vertexPath, fragmentPath, defines, program, linked, 0, 0, 0, 0};
+    shaderPrograms.push_back(entry);
+}
+
+/* The defines go on the line after #version, which has to stay first */
+void insertDefines(std::string& code, const char* defines)
+{
+    if (!defines)
+        return;
+    size_t version = code.find("#version");
+    size_t at = version == std::string::npos ? 0 : code.find('\n', version);
+    at = at == std::string::npos ? code.size() : at+1;
+    code.insert(at, std::string(defines) + "\n#line 2\n");
+}
+
+GLuint issueCompile(GLenum type, const std::string& code)
+{
+    GLuint shader = glCreateShader(type);
+    const char* source = code.c_str();
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+/* Load the sources and queue the compiles, or take the program from the cache. False if a file is missing. */
+bool issueProgramCompile(ShaderProgram& entry)
+{
+    std::string vertexCode, fragmentCode;
+    if (!loadShaderSource(entry.vertexPath, vertexCode) || !loadShaderSource(entry.fragmentPath, fragmentCode))
+        return false;
+    insertDefines(vertexCode, entry.defines);
+    insertDefines(fragmentCode, entry.defines);
+    entry.key = shaderCacheKey(vertexCode, fragmentCode);
+    entry.id = loadProgramBinary(entry.key);
+    if (entry.id) {
+        printf("Loaded cached program for %s and %s\n", entry.vertexPath, entry.fragmentPath);
+        entry.vertexShader = entry.fragmentShader = 0;
+        return true;
+    }
+    printf("Compiling shaders : %s and %s%s%s\n", entry.vertexPath, entry.fragmentPath,
+           entry.defines ? " with " : "", entry.defines ? entry.defines : "");
+    entry.vertexShader = issueCompile(GL_VERTEX_SHADER, vertexCode);
+    entry.fragmentShader = issueCompile(GL_FRAGMENT_SHADER, fragmentCode);
+    return true;
+}
+
+/* Queue the link of compiled shaders, status unread */
+void issueProgramLink(ShaderProgram& entry)
+{
+    if (!entry.vertexShader)
+        return;  // from the cache, already linked
+    entry.id = glCreateProgram();
+    glAttachShader(entry.id, entry.vertexShader);
+    glAttachShader(entry.id, entry.fragmentShader);
+    prepareProgramBinary(entry.id);
+    glLinkProgram(entry.id);
+}
+
+/* True once reading the build's result will not wait on the compiler */
+bool programBuildDone(const ShaderProgram& entry)
+{
+    GLint done = GL_TRUE;
+    if (entry.vertexShader && parallelShaderCompile())
+        glGetProgramiv(entry.id, GL_COMPLETION_STATUS_KHR, &done);
+    return done;
+}
+
+void printBuildLog(GLuint object, bool program)
+{
+    GLint length = 0;
+    if (program)
+        glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+    else
+        glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+    if (length <= 1)
+        return;
+    std::vector<char> log(length);
+    if (program)
+        glGetProgramInfoLog(object, length, NULL, &log[0]);
+    else
+        glGetShaderInfoLog(object, length, NULL, &log[0]);
+    fprintf(stderr, "%s\n", &log[0]);
+}
+
+/* Abandon a build in flight */
+void dropProgramBuild(ShaderProgram& entry)
+{
+    if (entry.vertexShader) {
+        glDeleteShader(entry.vertexShader);
+        glDeleteShader(entry.fragmentShader);
+    }
+    if (entry.id)
+        glDeleteProgram(entry.id);
+    entry.id = entry.vertexShader = entry.fragmentShader = 0;
+}
+
+/* Read the build's result. A program that linked replaces the entry's old one and is cached,
+   one that failed prints its logs and is dropped, leaving the old program in place. */
+bool finishProgramBuild(ShaderProgram& entry)
+{
+    GLint linked = GL_FALSE;
+    glGetProgramiv(entry.id, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        fprintf(stderr, "Shaders : %s and %s failed to build\n", entry.vertexPath, entry.fragmentPath);
+        if (entry.vertexShader) {
+            printBuildLog(entry.vertexShader, false);
+            printBuildLog(entry.fragmentShader, false);
+        }
+        printBuildLog(entry.id, true);
+        dropProgramBuild(entry);
+        return false;
+    }
+    if (entry.vertexShader) {
+        glDetachShader(entry.id, entry.vertexShader);
+        glDetachShader(entry.id, entry.fragmentShader);
+        glDeleteShader(entry.vertexShader);
+        glDeleteShader(entry.fragmentShader);
+        saveProgramBinary(entry.id, entry.key);
+    }
+    if (*entry.program)
+        glDeleteProgram(*entry.program);
+    *entry.program = entry.id;
+    entry.id = entry.vertexShader = entry.fragmentShader = 0;
+    if (entry.linked)
+        entry.linked(*entry.program);
+    return true;
+}
+
+/* Build every registered program. False, with the logs printed, if any of them failed. */
+bool buildShaderPrograms()
+{
+    TRACE_SCOPE("buildShaderPrograms");
+    bool ok = true;
+    for (size_t i = 0; i < shaderPrograms.size(); i++)
+        if (!issueProgramCompile(shaderPrograms[i]))
+            ok = false;
+    for (size_t i = 0; i < shaderPrograms.size(); i++)
+        issueProgramLink(shaderPrograms[i]);
+    for (size_t i = 0; i < shaderPrograms.size(); i++)
+        if (shaderPrograms[i].id && !finishProgramBuild(shaderPrograms[i]))
+            ok = false;
+    return ok;
+}
+
+#endif
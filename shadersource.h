@@ -0,0 +1,138 @@
+/* GLSL source loading : whole-file reads, #include expansion and shaders built into the binary */
+/* Needs no GL. The program defines embeddedShaders[], usually by including the embedded_shaders.h
+   that make generates from its shader files */
+#ifndef SHADERSOURCE_H
+#define SHADERSOURCE_H
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+/* By default shaders come from the copies compiled into the program, so starting up reads no
+   files. Setting shaderDirectory (the -shaders option) loads them from that directory instead,
+   for editing shaders without rebuilding.
+
+   A line of the form
+       #include "common.glsl"
+   is replaced by that file's text, named relative to the including file, between #line
+   directives so compile errors keep their line numbers. Each file gets its own GLSL source
+   string number, in the order the files are first included, the shader itself being 0, so an
+   error in an included file reads as 1(12) rather than a line of the includer. Includes nest up
+   to SHADER_INCLUDE_DEPTH deep. Every file is read once and kept until forgetShaderFiles(). */
+
+#define SHADER_INCLUDE_DEPTH 16
+
+struct EmbeddedShader {
+    const char* name;
+    const char* source;
+};
+extern EmbeddedShader embeddedShaders[];  // ends with {NULL, NULL}
+
+const char* shaderDirectory = NULL;
+std::map<std::string, std::string> shaderFiles;  // contents by path
+
+void forgetShaderFiles()
+{
+    shaderFiles.clear();
+}
+
+/* A file's contents in one read */
+bool readShaderFile(const char* path, std::string& text)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    text.resize(size > 0 ? size : 0);
+    bool ok = size >= 0 && (size == 0 || fread(&text[0], 1, size, file) == (size_t) size);
+    fclose(file);
+    return ok;
+}
+
+/* The text of a shader file, from the cache, the shader directory or the embedded copies */
+const std::string* shaderFile(const std::string& name)
+{
+    std::map<std::string, std::string>::iterator found = shaderFiles.find(name);
+    if (found != shaderFiles.end())
+        return &found->second;
+    std::string text;
+    if (shaderDirectory) {
+        if (!readShaderFile((std::string(shaderDirectory) + "/" + name).c_str(), text))
+            return NULL;
+    }
+    else {
+        int i = 0;
+        while (embeddedShaders[i].name && name != embeddedShaders[i].name)
+            i++;
+        if (!embeddedShaders[i].name)
+            return NULL;
+        text = embeddedShaders[i].source;
+    }
+    return &(shaderFiles[name] = text);
+}
+
+/* Source string number of name, numbering it when new */
+int shaderSourceNumber(const std::string& name, std::vector<std::string>& files)
+{
+    for (int i = 0; i < (int) files.size(); i++)
+        if (files[i] == name)
+            return i;
+    files.push_back(name);
+    return files.size()-1;
+}
+
+/* Append name's text to code with its includes expanded. files holds the names by source
+   string number, the shader itself first. */
+bool expandShaderSource(const std::string& name, std::string& code, int depth, std::vector<std::string>& files)
+{
+    const std::string* text = shaderFile(name);
+    if (!text) {
+        fprintf(stderr, "Shaders: cannot open %s%s%s\n", shaderDirectory ? shaderDirectory : "",
+                shaderDirectory ? "/" : "", name.c_str());
+        return false;
+    }
+    std::string directory = name.substr(0, name.find_last_of('/')+1);
+    int number = shaderSourceNumber(name, files);
+    int lineNumber = 1;
+    for (size_t at = 0; at < text->size(); lineNumber++) {
+        size_t end = text->find('\n', at);
+        end = end == std::string::npos ? text->size() : end+1;
+        const char* line = text->c_str()+at;
+        while (*line == ' ' || *line == '\t')
+            line++;
+        char included[256];
+        if (!strncmp(line, "#include", 8) && sscanf(line+8, " \"%255[^\"]\"", included) == 1) {
+            if (depth >= SHADER_INCLUDE_DEPTH) {
+                fprintf(stderr, "Shaders: %s:%d: includes nest too deep\n", name.c_str(), lineNumber);
+                return false;
+            }
+            std::string path = directory + included;
+            char start[32];
+            snprintf(start, sizeof(start), "#line 1 %d\n", shaderSourceNumber(path, files));
+            code += start;
+            if (!expandShaderSource(path, code, depth+1, files))
+                return false;
+            char resume[32];
+            snprintf(resume, sizeof(resume), "\n#line %d %d\n", lineNumber+1, number);
+            code += resume;
+        }
+        else
+            code.append(*text, at, end-at);
+        at = end;
+    }
+    return true;
+}
+
+/* A shader's full source, includes expanded. False, with a message, when a file is missing. */
+bool loadShaderSource(const char* name, std::string& code)
+{
+    code.clear();
+    std::vector<std::string> files;
+    return expandShaderSource(name, code, 0, files);
+}
+
+#endif
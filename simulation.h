@@ -0,0 +1,288 @@
+/* The GLFW sample's game simulation : the bodies, their motion and the collision responses */
+/* Needs no GL, so sample2D and the headless build run the same code. Include after glm and physics.h */
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <cmath>
+#include <vector>
+
+#include "trace.h"
+
+// All body state lives in the store, these name its arrays
+BodyStore bodies;
+std::vector< std::vector<CollisionCircle> >& centre=bodies.centre;
+std::vector<glm::vec3>& trans=bodies.trans;
+std::vector<float>& rotat=bodies.rotat;
+std::vector<float>& velx=bodies.velx;
+std::vector<float>& vely=bodies.vely;
+std::vector<char>& movable=bodies.movable;
+std::vector<float>& Timer=bodies.Timer;
+std::vector<float>& Mass=bodies.Mass;
+std::vector<float>& startX=bodies.startX;
+std::vector<float>& startY=bodies.startY;
+std::vector<float>& currentX=bodies.currentX;
+std::vector<float>& currentY=bodies.currentY;
+int ball,ground,wall; // body slots, created by createScene
+float COR=0.6f;
+float ADG=1.0f;
+float tick=0.3f;
+int buttonPressed=0;  // 1 once the ball has been fired
+float rotateBarrel=0; // cannon angle in degrees
+
+float sqr(float x)
+{
+    return x*x;
+}
+// centre[] placed by trans[]/rotat[], refreshed on use
+const WorldCircles& bodyCircles(int i)
+{
+    return updateWorldCircles(bodies.world[i],trans[i],rotat[i],centre[i]);
+}
+
+int collisionChecks=0; // checkCollision calls since the last trace counter sample
+bool checkCollision(int i,int j)
+{
+    collisionChecks++;
+    return circlesOverlap(bodyCircles(i),bodyCircles(j));
+}
+
+void divideRect(int i,float width,float height)
+{
+    for(int j=0;j<(int)(width/(2.0*height));j++)
+    {
+        centre[i].push_back(std::make_pair(std::make_pair(-(2.0f*j+1.0f)*height,0.0f),height));
+    }
+    for(int j=0;j<(int)(width/(2.0*height));j++)
+    {
+        centre[i].push_back(std::make_pair(std::make_pair((2.0f*j+1.0f)*height,0.0f),height));
+    }
+}
+
+/*--------------------------------------------------------- MOTION ---------------------------------------------------------*/
+
+float equilib(int i)
+{
+    return (Mass[i]/0.3f)*((vely[i]*0.3f+1.0f)/(Mass[i]*ADG));
+}
+void conserveMomentum(int i,int j)
+{
+    float u1,u2,v1,v2;
+    u1=xvel(velx[i],0.3f,Mass[i],Timer[i]);
+    u2=xvel(velx[j],0.3f,Mass[j],Timer[j]);
+    v1=(((Mass[i]-COR*Mass[j])*u1)/(Mass[i]+Mass[j]))+(((Mass[j]+COR*Mass[j])*u2)/(Mass[i]+Mass[j]));
+    v2=u1*COR-u2*COR+v1;
+    velx[i]=v1;
+    velx[j]=v2;
+    u1=yvel(vely[i],0.3f,Mass[i],Timer[i],ADG);
+    u2=yvel(vely[j],0.3f,Mass[j],Timer[j],ADG);
+    v1=(((Mass[i]-COR*Mass[j])*u1)/(Mass[i]+Mass[j]))+(((Mass[j]+COR*Mass[j])*u2)/(Mass[i]+Mass[j]));
+    v2=u1*COR-u2*COR+v1;
+    vely[i]=v1;
+    vely[j]=v2;
+}
+bool flag=true;
+BroadphaseGrid collisionGrid=broadphaseGrid(64.0f);
+
+#define CONTACT_SKIN 0.5f // overlap a swept body is left with at its contact, clearance after a push-out
+
+// i at time T of its trajectory from (startX,startY)
+void placeAt(int i,float T)
+{
+    Timer[i]=T;
+    trans[i][0]=currentX[i]=startX[i]+xdis(velx[i],0.3f,Mass[i],T);
+    trans[i][1]=currentY[i]=startY[i]+ydis(vely[i],0.3f,Mass[i],T,ADG);
+}
+// Time at which i stops rising faster than 0.01 : 0 if it already has, never if it is falling
+float riseTime(int i)
+{
+    float terminal=(Mass[i]*ADG)/0.3f;
+    if(vely[i]>0.01f)
+        return (Mass[i]/0.3f)*std::log((vely[i]+terminal)/(0.01f+terminal));
+    return vely[i]<-0.01f ? HUGE_VALF : 0.0f;
+}
+// Move i (and j too when it is movable) along their new trajectories from time 0 until they part,
+// at most to maxTime. Each pass solves the separation in closed form along the velocities at the
+// time reached, and the second makes up for the curve of the path the first took as straight.
+void pushApart(int i,int j,float maxTime)
+{
+    float T=0.0f;
+    for(int pass=0;pass<2 && T<maxTime;pass++)
+    {
+        collisionChecks++;
+        float dx=xvel(velx[i],0.3f,Mass[i],T),dy=yvel(vely[i],0.3f,Mass[i],T,ADG);
+        if(movable[j])
+        {
+            dx-=xvel(velx[j],0.3f,Mass[j],T);
+            dy-=yvel(vely[j],0.3f,Mass[j],T,ADG);
+        }
+        float s=sweepSeparation(bodyCircles(i),bodyCircles(j),dx,dy,CONTACT_SKIN);
+        if(s<=0.0f)
+            return; // Apart, or not moving apart at all
+        T=T+s<maxTime ? T+s : maxTime;
+        placeAt(i,T);
+        if(movable[j])
+            placeAt(j,T);
+    }
+}
+// Earliest fraction of the move (dx,dy) at which i meets a fixed body, or -1. The fixed bodies
+// are found in collisionGrid, which applyCollisions built this step and which they have not left
+std::vector<int> impactCandidates; // bodies around the move firstImpact sweeps
+float firstImpact(int i,float dx,float dy)
+{
+    const WorldCircles& moving=bodyCircles(i);
+    Bounds swept=bodyBounds(moving,CONTACT_SKIN); // grown to cover the whole move
+    (dx<0.0f ? swept.minX : swept.maxX)+=dx;
+    (dy<0.0f ? swept.minY : swept.maxY)+=dy;
+    impactCandidates.clear();
+    bodiesInBox(collisionGrid,swept,impactCandidates);
+    float first=-1.0f;
+    for(int a=0;a<(int)impactCandidates.size();a++)
+    {
+        int j=impactCandidates[a];
+        if(j==i || movable[j])
+            continue;
+        collisionChecks++;
+        float t=sweepContact(moving,bodyCircles(j),dx,dy,CONTACT_SKIN);
+        if(t>=0.0f && (first<0.0f || t<first))
+            first=t;
+    }
+    return first;
+}
+void applyCollisions()
+{
+    TRACE_SCOPE("applyCollisions");
+    // Broadphase : only pairs whose boxes share a grid cell reach checkCollision
+    buildBroadphase(collisionGrid,bodies,2.0f);
+    for(int p=0;p<(int)collisionGrid.pairs.size();p++)
+    {
+        int i=collisionGrid.pairs[p].first,j=collisionGrid.pairs[p].second;
+        if( ((velx[i]!=0 || vely[i]!=0) || (velx[j]!=0 || vely[j]!=0) ) && (movable[i] || movable[j]) && checkCollision(i,j) )
+        {
+            if(!movable[i])
+            {
+                if(i==ground)
+                {
+                    vely[j]=-COR*yvel(vely[j],0.3f,Mass[j],Timer[j],ADG);
+                    startX[j]=trans[j][0];
+                    startY[j]=trans[j][1];
+                    Timer[j]=tick;
+                }
+            }
+            //else if(!movable[j])
+            else if(!movable[j])
+            {
+                if(j==ground)
+                {
+                    vely[i]=-COR*(vely[i]-ADG*Timer[i]);
+                    startX[i]=trans[i][0];
+                    startY[i]=trans[i][1];
+                    Timer[i]=0.0f;
+                    // Out of the ground, as long as it still rises
+                    pushApart(i,j,riseTime(i));
+                }
+                if(j==wall)
+                {
+                    velx[i]=-COR*xvel(velx[i],0.3f,Mass[i],Timer[i]);
+                    startX[i]=currentX[i];
+                    startY[i]=currentY[i];
+                    Timer[i]=0.0f;
+                    pushApart(i,j,HUGE_VALF);
+                }
+            }
+            else if(movable[i] && movable[j])
+            {
+                conserveMomentum(i,j);
+                // Iterate over all objects to move time frame - TODO
+                startX[i]=currentX[i];
+                startY[i]=currentY[i];
+                startX[j]=currentX[j];
+                startY[j]=currentY[j];
+                Timer[i]=tick;
+                Timer[j]=tick;
+                pushApart(i,j,HUGE_VALF);
+                flag=false;
+            }
+        }
+    }
+}
+
+void updatePositions()
+{
+    TRACE_SCOPE("updatePositions");
+    if(1-buttonPressed)
+    {
+        currentX[ball]=-280.f+40*cos(D2R(rotateBarrel));
+        currentY[ball]=-210.0f+40*sin(D2R(rotateBarrel));
+        startX[ball]=currentX[ball];
+        startY[ball]=currentY[ball];
+    }
+    for(int i=0;i<bodyCount(bodies);i++)
+    {
+        if(i==ball && buttonPressed==0)
+            continue; // Still sitting in the barrel
+        if(velx[i]!=0.0f || vely[i]!=0.0f)
+        {
+            float x=startX[i]+(velx[i]*Timer[i]);
+            float y=startY[i]+(vely[i]*Timer[i]-0.5*ADG*sqr(Timer[i]));
+            // Swept against the fixed bodies, so a fast shot stops at a thin wall instead of
+            // stepping past it : left touching it, at the time it got there
+            float t=firstImpact(i,x-trans[i][0],y-trans[i][1]);
+            if(t>=0.0f)
+            {
+                x=trans[i][0]+(x-trans[i][0])*t;
+                y=trans[i][1]+(y-trans[i][1])*t;
+                Timer[i]-=(1.0f-t)*tick;
+            }
+            currentX[i]=x;
+            currentY[i]=y;
+            trans[i][0]=currentX[i];
+            trans[i][1]=currentY[i];
+            Timer[i]+=tick;
+        }
+    }
+}
+
+/*--------------------------------------------------------- SCENE ---------------------------------------------------------*/
+
+/* Empty the store and create the bodies : the ball, the ground and the right wall */
+void createScene()
+{
+    bodies=BodyStore();
+    buttonPressed=0;
+    flag=true;
+    ball=createBody(bodies).index;
+    ground=createBody(bodies).index;
+    wall=createBody(bodies).index;
+    centre[ball].push_back(std::make_pair(std::make_pair(0.0f,0.0f),12.0f));
+    movable[ball]=true;
+    Mass[ball]=200.0f;
+    divideRect(ground,500.0f,10.0f);
+    trans[ground]=glm::vec3(0.0f,-290.0f,0.0f);
+    movable[ground]=false;
+    divideRect(wall,350.0f,10.0f);
+    trans[wall]=glm::vec3(640.0f,0.0f,0.0f);
+    rotat[wall]=90.0f;
+    movable[wall]=false;
+}
+
+/* Sit the unfired ball at the cannon's mouth, aimed angle degrees up with launch speed u */
+void aimBall(float angle,float u)
+{
+    rotateBarrel=angle;
+    startX[ball]=trans[ball][0]=-280+60*cos(angle*(M_PI/180));
+    startY[ball]=trans[ball][1]=-210+60*sin(angle*(M_PI/180));
+    velx[ball]=u*cos(angle*(M_PI/180));
+    vely[ball]=u*sin(angle*(M_PI/180));
+}
+
+/* One fixed step of the whole simulation */
+void stepSimulation()
+{
+    if(buttonPressed==1)
+    {
+        applyCollisions();
+    }
+    updatePositions();
+}
+
+#endif
@@ -0,0 +1,146 @@
+/* Event recorder writing Chrome trace-event JSON, loadable in Perfetto or chrome://tracing */
+/* Needs no GL. Build with -DTRACE_DISABLED to compile every TRACE_ macro away. */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+/* Each thread records into its own ring of TRACE_EVENTS events, so recording takes no lock; once
+   the ring is full the oldest events are overwritten. Nothing is recorded until startTrace()
+   names the output file, and the file is written when the program exits.
+
+       TRACE_SCOPE("name");           complete event from here to the end of the block
+       TRACE_COUNTER("name", value);  counter track sample
+
+   Names must be string literals (or otherwise outlive the program's run). */
+
+#define TRACE_EVENTS 65536
+
+struct TraceEvent {
+    const char* name;
+    char phase;      // 'X' complete, 'C' counter
+    double start;    // microseconds since startTrace()
+    double duration; // microseconds, or the counter's value
+};
+
+struct TraceBuffer {
+    std::vector<TraceEvent> events;
+    size_t recorded; // events ever recorded, the ring holds the last TRACE_EVENTS
+    int thread;
+};
+
+struct Trace {
+    bool enabled;
+    const char* path;
+    std::chrono::steady_clock::time_point origin;
+    std::mutex lock;                     // guards buffers
+    std::vector<TraceBuffer*> buffers;   // one per thread that recorded
+} trace;
+
+double traceNow()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now()-trace.origin).count();
+}
+
+/* This thread's ring, registered the first time the thread records */
+TraceBuffer& traceBuffer()
+{
+    static thread_local TraceBuffer* buffer = NULL;
+    if (!buffer) {
+        buffer = new TraceBuffer;
+        buffer->events.resize(TRACE_EVENTS);
+        buffer->recorded = 0;
+        std::lock_guard<std::mutex> guard(trace.lock);
+        buffer->thread = trace.buffers.size()+1;
+        trace.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void traceRecord(const char* name, char phase, double start, double duration)
+{
+    TraceBuffer& buffer = traceBuffer();
+    TraceEvent& event = buffer.events[buffer.recorded % TRACE_EVENTS];
+    event.name = name;
+    event.phase = phase;
+    event.start = start;
+    event.duration = duration;
+    buffer.recorded++;
+}
+
+struct TraceScope {
+    const char* name;
+    double start;
+    TraceScope(const char* eventName) : name(eventName), start(trace.enabled ? traceNow() : 0) {}
+    ~TraceScope()
+    {
+        if (trace.enabled)
+            traceRecord(name, 'X', start, traceNow()-start);
+    }
+};
+
+/* Every thread's events as one JSON object, oldest first per thread */
+bool writeTrace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Trace: cannot write %s\n", path);
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(trace.lock);
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (size_t b = 0; b < trace.buffers.size(); b++) {
+        const TraceBuffer& buffer = *trace.buffers[b];
+        size_t begin = buffer.recorded > TRACE_EVENTS ? buffer.recorded-TRACE_EVENTS : 0;
+        for (size_t i = begin; i < buffer.recorded; i++) {
+            const TraceEvent& event = buffer.events[i % TRACE_EVENTS];
+            fprintf(file, first ? " " : ",\n ");
+            first = false;
+            if (event.phase == 'C')
+                fprintf(file, "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"value\":%.17g}}",
+                        event.name, event.start, buffer.thread, event.duration);
+            else
+                fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                        event.name, event.start, event.duration, buffer.thread);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+void writeTraceAtExit()
+{
+    trace.enabled = false;
+    writeTrace(trace.path);
+}
+
+/* Start recording, the trace goes to path when the program exits */
+void startTrace(const char* path)
+{
+#ifndef TRACE_DISABLED
+    trace.path = path;
+    trace.origin = std::chrono::steady_clock::now();
+    trace.enabled = true;
+    atexit(writeTraceAtExit);
+#else
+    fprintf(stderr, "Trace: built with TRACE_DISABLED, %s not written\n", path);
+#endif
+}
+
+#ifndef TRACE_DISABLED
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_JOIN(traceScope, __LINE__)(name)
+#define TRACE_COUNTER(name, value) do { if (trace.enabled) traceRecord(name, 'C', traceNow(), (double)(value)); } while (0)
+#else
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_COUNTER(name, value) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,148 @@
+/* Trajectory preview : the path a shot aimed now would take, up to the first body it meets, as one line strip */
+/* Include after render.h */
+#ifndef TRAJECTORYPREVIEW_H
+#define TRAJECTORYPREVIEW_H
+
+#include <vector>
+
+#include "trace.h"
+
+/* The path is sampled at evenly spaced times, all at once with dragTrajectory() (or as a plain
+   parabola when drag is 0). The chord between each two samples is then swept with the shot's
+   circles against the bodies the broadphase grid holds around it, and the strip ends at the
+   first contact. Sampling, the sweep and the upload all happen only when the aim differs from
+   the one the strip was built for, so updating every frame or every cursor move costs nothing
+   while the aim holds still, and one buffer is drawn with one call whatever the number of samples. */
+
+struct TrajectoryPreview {
+    float duration;         // time the path covers
+    float drag;             // air friction K, 0 for a plain parabola
+    GLubyte r, g, b;
+    float aim[6];           // startX, startY, velx, vely, mass, gravity the strip was built for
+    std::vector<float> startX, startY, velx, vely, mass, T;  // dragTrajectory() input, one per sample
+    std::vector<float> x, y, vx, vy;                         // and its output
+    WorldCircles probe;     // the shot's circles at the start of the chord being swept
+    std::vector<int> nearby;  // bodies around that chord
+    std::vector<Vertex> vertices;
+    int hit;                // body the path ends on, -1 if it meets none
+    VAO* vao;               // NULL until the first update
+};
+
+TrajectoryPreview trajectoryPreview(int samples, float duration, float drag, GLubyte r, GLubyte g, GLubyte b)
+{
+    TrajectoryPreview preview;
+    preview.duration = duration;
+    preview.drag = drag;
+    preview.r = r;
+    preview.g = g;
+    preview.b = b;
+    preview.T.resize(samples);
+    for (int k=0; k<samples; k++)
+        preview.T[k] = duration*k/(samples-1);
+    preview.x.resize(samples);
+    preview.y.resize(samples);
+    preview.vx.resize(samples);
+    preview.vy.resize(samples);
+    preview.probe.valid = false;
+    preview.hit = -1;
+    preview.vao = NULL;
+    return preview;
+}
+
+/* Sample the path from (startX,startY) at velocity (velx,vely) into x[], y[] */
+void sampleTrajectory(TrajectoryPreview& preview, float startX, float startY, float velx, float vely, float mass, float gravity)
+{
+    int n = preview.T.size();
+    if (preview.drag > 0.0f) {
+        preview.startX.assign(n, startX);
+        preview.startY.assign(n, startY);
+        preview.velx.assign(n, velx);
+        preview.vely.assign(n, vely);
+        preview.mass.assign(n, mass);
+        dragTrajectory(n, &preview.startX[0], &preview.startY[0], &preview.velx[0], &preview.vely[0], &preview.mass[0], &preview.T[0],
+                       preview.drag, gravity, &preview.x[0], &preview.y[0], &preview.vx[0], &preview.vy[0]);
+        return;
+    }
+    for (int k=0; k<n; k++) {
+        float t = preview.T[k];
+        preview.x[k] = startX + velx*t;
+        preview.y[k] = startY + vely*t - 0.5f*gravity*t*t;
+    }
+}
+
+/* First chord (samples k to k+1) along which the shape meets a body of the grid other than
+   body, or -1. The body goes in preview.hit and the fraction of the chord covered in *fraction.
+   stops, when given, picks which bodies the path can end on. */
+int firstPreviewImpact(TrajectoryPreview& preview, const BodyStore& store, int body, const BroadphaseGrid& grid, bool (*stops)(int), float* fraction)
+{
+    preview.hit = -1;
+    for (int k=0; k+1<(int)preview.T.size(); k++) {
+        float dx = preview.x[k+1]-preview.x[k], dy = preview.y[k+1]-preview.y[k];
+        const WorldCircles& moving = updateWorldCircles(preview.probe, glm::vec3(preview.x[k], preview.y[k], 0.0f), 0.0f, store.centre[body]);
+        Bounds swept = bodyBounds(moving, 0.0f);
+        (dx < 0.0f ? swept.minX : swept.maxX) += dx;
+        (dy < 0.0f ? swept.minY : swept.maxY) += dy;
+        preview.nearby.clear();
+        bodiesInBox(grid, swept, preview.nearby);
+        float first = -1.0f;
+        for (int a=0; a<(int)preview.nearby.size(); a++) {
+            int j = preview.nearby[a];
+            if (j == body || (stops && !stops(j)))
+                continue;
+            float t = sweepContact(moving, store.world[j], dx, dy, 0.0f);
+            if (t >= 0.0f && (first < 0.0f || t < first)) {
+                first = t;
+                preview.hit = j;
+            }
+        }
+        if (first >= 0.0f) {
+            *fraction = first;
+            return k;
+        }
+    }
+    return -1;
+}
+
+/* Rebuild the strip for body launched from (startX,startY) at (velx,vely), if that is not the
+   aim it already holds. The grid must be built over the bodies where they are now, which also
+   leaves their circles placed in store.world. */
+void updateTrajectoryPreview(TrajectoryPreview& preview, const BodyStore& store, int body, const BroadphaseGrid& grid,
+                             float startX, float startY, float velx, float vely, float gravity, bool (*stops)(int))
+{
+    float aim[6] = {startX, startY, velx, vely, store.Mass[body], gravity};
+    bool same = preview.vao != NULL;
+    for (int a=0; a<6 && same; a++)
+        same = aim[a] == preview.aim[a];
+    if (same)
+        return;
+    TRACE_SCOPE("updateTrajectoryPreview");
+    for (int a=0; a<6; a++)
+        preview.aim[a] = aim[a];
+
+    sampleTrajectory(preview, startX, startY, velx, vely, aim[4], gravity);
+    float fraction = 1.0f;
+    int chord = firstPreviewImpact(preview, store, body, grid, stops, &fraction);
+    int points = chord < 0 ? preview.T.size() : chord+1;
+    preview.vertices.clear();
+    for (int k=0; k<points; k++) {
+        Vertex v = {preview.x[k], preview.y[k], 0.0f, preview.r, preview.g, preview.b, 255};
+        preview.vertices.push_back(v);
+    }
+    if (chord >= 0) {
+        // Ends where the shot touches what it hits
+        Vertex v = {preview.x[chord] + (preview.x[chord+1]-preview.x[chord])*fraction,
+                    preview.y[chord] + (preview.y[chord+1]-preview.y[chord])*fraction, 0.0f, preview.r, preview.g, preview.b, 255};
+        preview.vertices.push_back(v);
+    }
+
+    if (!preview.vao) {
+        preview.vao = create3DObject(GL_LINE_STRIP, preview.vertices.size(), &preview.vertices[0], 0, NULL, GL_LINE);
+    }
+    else {
+        glBindBuffer (GL_ARRAY_BUFFER, preview.vao->VertexBuffer);
+        glBufferData (GL_ARRAY_BUFFER, preview.vertices.size()*sizeof(Vertex), &preview.vertices[0], GL_DYNAMIC_DRAW);
+    }
+    preview.vao->NumVertices = preview.vertices.size();
+}
+
+#endif